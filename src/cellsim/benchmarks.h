@@ -0,0 +1,121 @@
+#pragma once
+
+#include <chrono>
+#include <iostream>
+#include <string>
+
+#include "../doctest.h"
+
+#include "grid.h"
+
+// Benchmarks are test cases that are skipped by default. Run them with
+//   ./cellsim --no-skip --test-case="benchmark*"
+// They print time of every measured workload and check only that compared variants give the same results.
+
+// runs function several times and returns the best time in milliseconds
+template <typename Function>
+double measureMilliseconds(Function function, int repetitions = 3) {
+    double best = 0.0;
+    for (int i = 0; i < repetitions; ++i) {
+        auto start = std::chrono::steady_clock::now();
+        function();
+        std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+        if (i == 0 || elapsed.count() < best) {
+            best = elapsed.count();
+        }
+    }
+    return best;
+}
+
+void printBenchmarkResult(const std::string& name, double milliseconds) {
+    std::cout << "  " << name << ": " << milliseconds << " ms" << std::endl;
+}
+
+template <typename Layout>
+BasicGrid<int, Layout> makeBenchmarkGrid(const Grid& source) {
+    BasicGrid<int, Layout> grid(source.getRows(), source.getCols());
+    for (int r = 0; r < source.getRows(); ++r) {
+        for (int c = 0; c < source.getCols(); ++c) {
+            grid.setCellValue(r, c, source.getCellValue(r, c));
+        }
+    }
+    return grid;
+}
+
+// Morton grids are updated tile by tile; 256 x 4096 is a whole number of 64 x 64 tiles, so both layouts
+// use the same memory (other shapes are padded by less than one tile per side, see MortonLayout)
+TEST_CASE("benchmark: row-major vs Morton layout" * doctest::skip()) {
+    for (auto [rows, cols] : {std::pair<int, int>{1024, 1024}, {256, 4096}}) {
+        Grid source(rows, cols);
+        source.fillGridWithRandomValues({0, 1}, {0.7, 0.3});
+        auto rowMajor = makeBenchmarkGrid<RowMajorLayout>(source);
+        auto morton = makeBenchmarkGrid<MortonLayout>(source);
+
+        std::cout << rows << " x " << cols << " grid (" << rowMajor.memoryBytes() << " bytes row-major, "
+                  << morton.memoryBytes() << " bytes Morton)" << std::endl;
+        printBenchmarkResult("stencil update, row-major", measureMilliseconds([&] { rowMajor.update(); }));
+        printBenchmarkResult("stencil update, Morton", measureMilliseconds([&] { morton.update(); }));
+        CHECK(rowMajor.gridToString() == morton.gridToString());
+
+        size_t rowMajorRegions = 0;
+        size_t mortonRegions = 0;
+        printBenchmarkResult("find regions, row-major", measureMilliseconds([&] {
+            rowMajorRegions = rowMajor.getNonInteractingRegions().size();
+        }));
+        printBenchmarkResult("find regions, Morton", measureMilliseconds([&] {
+            mortonRegions = morton.getNonInteractingRegions().size();
+        }));
+        CHECK(rowMajorRegions == mortonRegions);
+    }
+}
+
+TEST_CASE("benchmark: parallel NUMA-aware update" * doctest::skip()) {
+    ByteGrid grid(2048, 2048);
+    grid.fillGridWithRandomValues({0, 1}, {0.7, 0.3});
+    ByteGrid serialGrid = grid;
+
+    std::cout << "2048 x 2048 byte grid, " << getNumaNodes().size() << " NUMA node(s)" << std::endl;
+    printBenchmarkResult("serial update", measureMilliseconds([&] { serialGrid.update(); }));
+
+    ParallelUpdater parallelUpdater;
+    printBenchmarkResult("parallel update, " + std::to_string(parallelUpdater.getThreadCount()) + " threads",
+                         measureMilliseconds([&] { grid.update(parallelUpdater); }));
+    CHECK(grid.gridToString() == serialGrid.gridToString());
+
+    const ParallelUpdateStats& stats = parallelUpdater.getLastStats();
+    std::cout << "  pinned threads: " << stats.pinnedThreads << std::endl;
+    for (const auto& node : stats.nodes) {
+        std::cout << "  node " << node.node << ": " << node.threads << " threads, "
+                  << node.estimatedGigabytesPerSecond() << " GB/s (estimated)" << std::endl;
+    }
+}
+
+TEST_CASE("benchmark: parallel region labeling" * doctest::skip()) {
+    ByteGrid grid(4096, 4096);
+    grid.fillGridWithRandomValues({0, 1}, {0.6, 0.4});
+
+    std::cout << "4096 x 4096 byte grid" << std::endl;
+    std::size_t serialRegions = 0;
+    printBenchmarkResult("serial labeling", measureMilliseconds([&] {
+        serialRegions = RegionLabeler().label(grid.getCells()).regionCount;
+    }));
+    ParallelRegionLabeler parallelLabeler;
+    std::size_t parallelRegions = 0;
+    printBenchmarkResult("parallel labeling, " + std::to_string(parallelLabeler.getThreadCount()) + " threads",
+                         measureMilliseconds([&] {
+        parallelRegions = parallelLabeler.label(grid.getCells()).regionCount;
+    }));
+    CHECK(serialRegions == parallelRegions);
+
+    BitGrid bits(4096, 4096);
+    for (int r = 0; r < 4096; ++r) {
+        for (int c = 0; c < 4096; ++c) {
+            bits.setCellValue(r, c, grid.getCellValue(r, c) != 0);
+        }
+    }
+    std::size_t runRegions = 0;
+    printBenchmarkResult("run-length labeling of bit grid", measureMilliseconds([&] {
+        runRegions = RunLengthLabeler().label(bits.getCells()).regionCount;
+    }));
+    CHECK(runRegions == serialRegions);
+}
@@ -1,27 +1,46 @@
 #pragma once
+#include <cstdint>
+#include <vector>
+
 #include "../doctest.h"
 
-class Cell {
+// Cell that stores a value of type ValueT.
+// int is the default (see Cell below); small-state automata can use narrower types
+// like std::uint8_t, binary automata can use bool with bit-packed storage (see cell_buffer.h)
+template <typename ValueT>
+class BasicCell {
 public:
-    Cell(int value = 0) : value(value) {}
+    using ValueType = ValueT;
+
+    BasicCell(ValueT value = ValueT{}) : value(value) {}
 
-    int getValue() const {
+    ValueT getValue() const {
         return value;
     }
 
-    void setValue(int newValue) {
+    void setValue(ValueT newValue) {
         value = newValue;
     }
 
     // Implementing the equality operator
-    bool operator==(const Cell& other) const {
+    bool operator==(const BasicCell& other) const {
         return value == other.value;
     }
 
 private:
-    int value;
+    ValueT value;
 };
 
+using Cell = BasicCell<int>;
+
+// Converts cell value to something that is printed as a number:
+// std::uint8_t would be printed as a character and bool as 0/1 only by accident of stream flags,
+// so we promote them to int. int values are returned as is.
+template <typename ValueT>
+auto toPrintableValue(ValueT value) {
+    return +value;
+}
+
 TEST_CASE("empty cell has value 0") {
     Cell cell;
     CHECK(cell.getValue() == 0);
@@ -44,4 +63,16 @@ TEST_CASE("compare vector of cells") {
     std::vector<Cell> vector1 { Cell(1), Cell(2), Cell(3)};
     std::vector<Cell> vector2 { Cell(1), Cell(2), Cell(3)};
     CHECK(vector1 == vector2);
-}
\ No newline at end of file
+}
+
+TEST_CASE("cells with narrow value types") {
+    BasicCell<std::uint8_t> byteCell(200);
+    CHECK(byteCell.getValue() == 200);
+    CHECK(sizeof(byteCell) == 1);
+    CHECK(toPrintableValue(byteCell.getValue()) == 200); // printed as number, not as character
+
+    BasicCell<bool> bitCell;
+    CHECK(bitCell.getValue() == false);
+    bitCell.setValue(true);
+    CHECK(toPrintableValue(bitCell.getValue()) == 1);
+}
@@ -0,0 +1,332 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include <utility>
+#include <cassert>
+
+#include "../doctest.h"
+
+#include "cell.h"
+#include "cell_layout.h"
+#include "grid_allocator.h"
+
+// Storage for rows x cols cells of a grid.
+// Cells are kept in one contiguous block instead of vector of vectors,
+// so memory used by the grid is proportional to the size of the value type.
+// Layout defines order of cells in the block (row-major by default, see cell_layout.h).
+// The block is aligned to cache line, large blocks are aligned to 2M, request transparent huge pages and are not touched
+// until cells are written (see grid_allocator.h).
+template <typename ValueT, typename Layout = RowMajorLayout>
+class CellBuffer {
+public:
+    using ValueType = ValueT;
+    using LayoutType = Layout;
+    using CellType = BasicCell<ValueT>;
+    using reference = CellType&;
+    using const_reference = const CellType&;
+
+    // type and number of elements in the storage of the buffer
+    using StorageType = CellType;
+
+    static std::size_t storageSize(int rows, int cols) {
+        return Layout(rows, cols).size();
+    }
+
+    CellBuffer(int rows = 0, int cols = 0)
+        : rows(rows), cols(cols), layout(rows, cols), cells(layout.size()) {}
+
+    // buffer over given storage (for example, GridArray::view of memory-mapped file),
+    // storage should have storageSize(rows, cols) elements
+    CellBuffer(int rows, int cols, GridArray<StorageType> storage)
+        : rows(rows), cols(cols), layout(rows, cols), cells(std::move(storage)) {
+        assert(cells.size() == layout.size());
+    }
+
+    CellBuffer(const CellBuffer&) = default;
+    CellBuffer& operator=(const CellBuffer&) = default;
+
+    // moved-from buffer becomes empty 0x0 buffer, so its dimensions match its (stolen) storage
+    CellBuffer(CellBuffer&& other) noexcept
+        : rows(std::exchange(other.rows, 0)), cols(std::exchange(other.cols, 0)),
+          layout(std::exchange(other.layout, Layout(0, 0))), cells(std::move(other.cells)) {
+    }
+
+    CellBuffer& operator=(CellBuffer&& other) noexcept {
+        rows = std::exchange(other.rows, 0);
+        cols = std::exchange(other.cols, 0);
+        layout = std::exchange(other.layout, Layout(0, 0));
+        cells = std::move(other.cells);
+        return *this;
+    }
+
+    int getRows() const { return rows; }
+
+    int getCols() const { return cols; }
+
+    const Layout& getLayout() const { return layout; }
+
+    reference at(int row, int col) {
+        return cells[index(row, col)];
+    }
+
+    const_reference at(int row, int col) const {
+        return cells[index(row, col)];
+    }
+
+    ValueT getValue(int row, int col) const {
+        return cells[index(row, col)].getValue();
+    }
+
+    void setValue(int row, int col, ValueT value) {
+        cells[index(row, col)].setValue(value);
+    }
+
+    // number of bytes used to store cell values
+    std::size_t memoryBytes() const {
+        return cells.size() * sizeof(CellType);
+    }
+
+    bool operator==(const CellBuffer& other) const {
+        return rows == other.rows && cols == other.cols && cells == other.cells;
+    }
+
+    bool operator!=(const CellBuffer& other) const {
+        return !(*this == other);
+    }
+
+private:
+    std::size_t index(int row, int col) const {
+        return layout.index(row, col);
+    }
+
+    int rows;
+    int cols;
+    Layout layout;
+    GridArray<CellType> cells;
+};
+
+// Bit-packed cells can't be referenced directly, so this proxy plays the role of Cell&
+class BitCellReference {
+public:
+    BitCellReference(std::uint64_t& word, std::uint64_t mask) : word(word), mask(mask) {}
+
+    bool getValue() const {
+        return (word & mask) != 0;
+    }
+
+    void setValue(bool newValue) {
+        if (newValue) {
+            word |= mask;
+        } else {
+            word &= ~mask;
+        }
+    }
+
+private:
+    std::uint64_t& word;
+    std::uint64_t mask;
+};
+
+// Binary cells: 64 cells per machine word, 32 times less memory than int cells.
+// Each row starts at a word boundary, so whole rows can be processed word by word.
+// (with other layouts bool cells are stored one per byte by the general template)
+template <>
+class CellBuffer<bool, RowMajorLayout> {
+public:
+    using ValueType = bool;
+    using LayoutType = RowMajorLayout;
+    using CellType = BasicCell<bool>;
+    using reference = BitCellReference;
+    using const_reference = CellType; // returned by value - there is nothing to refer to
+
+    static constexpr int bitsPerWord = 64;
+
+    using StorageType = std::uint64_t;
+
+    static std::size_t storageSize(int rows, int cols) {
+        return static_cast<std::size_t>(rows) * ((cols + bitsPerWord - 1) / bitsPerWord);
+    }
+
+    CellBuffer(int rows = 0, int cols = 0)
+        : rows(rows), cols(cols), wordsPerRow((cols + bitsPerWord - 1) / bitsPerWord),
+          words(static_cast<std::size_t>(rows) * wordsPerRow) {}
+
+    CellBuffer(int rows, int cols, GridArray<StorageType> storage)
+        : rows(rows), cols(cols), wordsPerRow((cols + bitsPerWord - 1) / bitsPerWord),
+          words(std::move(storage)) {
+        assert(words.size() == storageSize(rows, cols));
+    }
+
+    CellBuffer(const CellBuffer&) = default;
+    CellBuffer& operator=(const CellBuffer&) = default;
+
+    CellBuffer(CellBuffer&& other) noexcept
+        : rows(std::exchange(other.rows, 0)), cols(std::exchange(other.cols, 0)),
+          wordsPerRow(std::exchange(other.wordsPerRow, 0)), words(std::move(other.words)) {
+    }
+
+    CellBuffer& operator=(CellBuffer&& other) noexcept {
+        rows = std::exchange(other.rows, 0);
+        cols = std::exchange(other.cols, 0);
+        wordsPerRow = std::exchange(other.wordsPerRow, 0);
+        words = std::move(other.words);
+        return *this;
+    }
+
+    int getRows() const { return rows; }
+
+    int getCols() const { return cols; }
+
+    int getWordsPerRow() const { return wordsPerRow; }
+
+    reference at(int row, int col) {
+        return BitCellReference(word(row, col), bitMask(col));
+    }
+
+    const_reference at(int row, int col) const {
+        return CellType(getValue(row, col));
+    }
+
+    bool getValue(int row, int col) const {
+        return (word(row, col) & bitMask(col)) != 0;
+    }
+
+    void setValue(int row, int col, bool value) {
+        at(row, col).setValue(value);
+    }
+
+    // words of a single row; bits past the last column are always 0
+    const std::uint64_t* rowWords(int row) const {
+        return words.data() + static_cast<std::size_t>(row) * wordsPerRow;
+    }
+
+    std::uint64_t* rowWords(int row) {
+        return words.data() + static_cast<std::size_t>(row) * wordsPerRow;
+    }
+
+    std::size_t memoryBytes() const {
+        return words.size() * sizeof(std::uint64_t);
+    }
+
+    bool operator==(const CellBuffer& other) const {
+        return rows == other.rows && cols == other.cols && words == other.words;
+    }
+
+    bool operator!=(const CellBuffer& other) const {
+        return !(*this == other);
+    }
+
+private:
+    static std::uint64_t bitMask(int col) {
+        return std::uint64_t{1} << (col % bitsPerWord);
+    }
+
+    std::uint64_t& word(int row, int col) {
+        return rowWords(row)[col / bitsPerWord];
+    }
+
+    const std::uint64_t& word(int row, int col) const {
+        return rowWords(row)[col / bitsPerWord];
+    }
+
+    int rows;
+    int cols;
+    int wordsPerRow;
+    GridArray<std::uint64_t> words;
+};
+
+TEST_CASE("CellBuffer stores values in row-major order") {
+    CellBuffer<int> buffer(2, 3);
+    CHECK(buffer.getRows() == 2);
+    CHECK(buffer.getCols() == 3);
+    CHECK(buffer.getValue(1, 2) == 0);
+
+    buffer.setValue(1, 2, 7);
+    buffer.at(0, 1).setValue(5);
+    CHECK(buffer.getValue(1, 2) == 7);
+    CHECK(buffer.at(0, 1).getValue() == 5);
+    CHECK(buffer.getValue(0, 2) == 0);
+}
+
+TEST_CASE("CellBuffer<bool> packs cells into bits") {
+    CellBuffer<bool> buffer(3, 70); // second word of each row is used partially
+    CHECK(buffer.getWordsPerRow() == 2);
+
+    buffer.setValue(1, 0, true);
+    buffer.setValue(1, 65, true);
+    buffer.at(2, 69).setValue(true);
+    CHECK(buffer.getValue(1, 0));
+    CHECK(buffer.getValue(1, 65));
+    CHECK(buffer.at(2, 69).getValue());
+    CHECK(!buffer.getValue(1, 1));
+    CHECK(!buffer.getValue(0, 65));
+
+    CHECK(buffer.rowWords(1)[0] == 1);
+    CHECK(buffer.rowWords(1)[1] == 2);
+
+    buffer.at(1, 65).setValue(false);
+    CHECK(!buffer.getValue(1, 65));
+}
+
+TEST_CASE("memory used by different cell types") {
+    CellBuffer<int> intBuffer(64, 64);
+    CellBuffer<std::uint8_t> byteBuffer(64, 64);
+    CellBuffer<bool> bitBuffer(64, 64);
+
+    CHECK(intBuffer.memoryBytes() == 4 * byteBuffer.memoryBytes());
+    CHECK(intBuffer.memoryBytes() == 32 * bitBuffer.memoryBytes());
+}
+
+TEST_CASE("moved-from CellBuffer is empty") {
+    CellBuffer<int> buffer(2, 3);
+    buffer.setValue(1, 1, 4);
+
+    CellBuffer<int> moved = std::move(buffer);
+    CHECK(moved.getValue(1, 1) == 4);
+    CHECK(buffer.getRows() == 0);
+    CHECK(buffer.getCols() == 0);
+    CHECK(buffer.memoryBytes() == 0);
+
+    CellBuffer<bool> bits(2, 3);
+    CellBuffer<bool> movedBits;
+    movedBits = std::move(bits);
+    CHECK(movedBits.getRows() == 2);
+    CHECK(bits.getRows() == 0);
+    CHECK(bits.memoryBytes() == 0);
+}
+
+TEST_CASE("CellBuffer with Morton layout") {
+    CellBuffer<int, MortonLayout> buffer(3, 5); // padded to 4 x 8 slots
+    CHECK(buffer.memoryBytes() == 32 * sizeof(Cell));
+    for (int r = 0; r < 3; ++r) {
+        for (int c = 0; c < 5; ++c) {
+            buffer.setValue(r, c, r * 10 + c);
+        }
+    }
+    for (int r = 0; r < 3; ++r) {
+        for (int c = 0; c < 5; ++c) {
+            CHECK(buffer.getValue(r, c) == r * 10 + c);
+        }
+    }
+
+    CellBuffer<int, MortonLayout> moved = std::move(buffer);
+    CHECK(moved.getValue(2, 4) == 24);
+    CHECK(buffer.getRows() == 0);
+    CHECK(buffer.memoryBytes() == 0);
+}
+
+TEST_CASE("large CellBuffer is mapped from the OS") {
+    GridAllocationStats before = GridAllocationCounters::get();
+    CellBuffer<int> buffer(1024, 1024);
+    GridAllocationStats after = GridAllocationCounters::get();
+
+#if defined(__linux__)
+    CHECK(after.aligned == before.aligned);
+    CHECK(after.hugeTlb + after.transparentHugePagesRequested + after.regularPages
+          == before.hugeTlb + before.transparentHugePagesRequested + before.regularPages + 1);
+#endif
+    buffer.setValue(1023, 1023, 1);
+    CHECK(buffer.getValue(1023, 1023) == 1);
+}
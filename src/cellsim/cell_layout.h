@@ -0,0 +1,177 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#if defined(__BMI2__)
+#include <immintrin.h>
+#endif
+
+#include "../doctest.h"
+
+// Layouts define where cell (row, col) is placed in the storage of CellBuffer.
+
+// Rows one after another. Horizontal neighbors are next to each other,
+// but vertical neighbors are a whole row apart.
+class RowMajorLayout {
+public:
+    RowMajorLayout(int rows, int cols) : rows(rows), cols(cols) {}
+
+    // number of storage slots needed for the grid
+    std::size_t size() const {
+        return static_cast<std::size_t>(rows) * cols;
+    }
+
+    std::size_t index(int row, int col) const {
+        return static_cast<std::size_t>(row) * cols + col;
+    }
+
+private:
+    int rows;
+    int cols;
+};
+
+// Spreads bits of value to even positions: bit i goes to bit 2*i
+inline std::uint64_t spreadBitsPortable(std::uint32_t value) {
+    std::uint64_t x = value;
+    x = (x | (x << 16)) & 0x0000FFFF0000FFFFull;
+    x = (x | (x << 8)) & 0x00FF00FF00FF00FFull;
+    x = (x | (x << 4)) & 0x0F0F0F0F0F0F0F0Full;
+    x = (x | (x << 2)) & 0x3333333333333333ull;
+    x = (x | (x << 1)) & 0x5555555555555555ull;
+    return x;
+}
+
+// Inverse of spreadBitsPortable: collects even bits of x
+inline std::uint32_t compactBitsPortable(std::uint64_t x) {
+    x &= 0x5555555555555555ull;
+    x = (x | (x >> 1)) & 0x3333333333333333ull;
+    x = (x | (x >> 2)) & 0x0F0F0F0F0F0F0F0Full;
+    x = (x | (x >> 4)) & 0x00FF00FF00FF00FFull;
+    x = (x | (x >> 8)) & 0x0000FFFF0000FFFFull;
+    x = (x | (x >> 16)) & 0x00000000FFFFFFFFull;
+    return static_cast<std::uint32_t>(x);
+}
+
+// Morton (Z-order) code: bits of col go to even positions, bits of row to odd positions.
+// With BMI2 instructions (compile with -mbmi2 or -march=native) one pdep per coordinate is enough.
+inline std::uint64_t mortonEncode(std::uint32_t row, std::uint32_t col) {
+#if defined(__BMI2__)
+    return _pdep_u64(col, 0x5555555555555555ull) | _pdep_u64(row, 0xAAAAAAAAAAAAAAAAull);
+#else
+    return spreadBitsPortable(col) | (spreadBitsPortable(row) << 1);
+#endif
+}
+
+// returns (row, col) of Morton code
+inline std::pair<std::uint32_t, std::uint32_t> mortonDecode(std::uint64_t code) {
+#if defined(__BMI2__)
+    return {static_cast<std::uint32_t>(_pext_u64(code, 0xAAAAAAAAAAAAAAAAull)),
+            static_cast<std::uint32_t>(_pext_u64(code, 0x5555555555555555ull))};
+#else
+    return {compactBitsPortable(code >> 1), compactBitsPortable(code)};
+#endif
+}
+
+// Z-order layout: cells close to each other in 2D (in any direction) are close in memory,
+// so stencil updates and flood fill touch fewer cache lines.
+// Grid is cut into square tiles of tileSize x tileSize cells (tileSize is a power of two, at most
+// maxTileSize, and not larger than the shorter side rounded up to a power of two). Cells inside a tile
+// are in Z-order, tiles are placed one after another in row-major order.
+// Rows and columns are rounded up to a multiple of tileSize, so each side gets less than one tile
+// of padding (256 x 4096 grid needs no padding, 1000 x 1000 grid takes 1024 x 1024 slots)
+// instead of being rounded up to a power of two.
+// Updater walks grids with this layout tile by tile (see Updater::updateRows).
+class MortonLayout {
+public:
+    static constexpr int maxTileBits = 6; // 64 x 64 cells, 16 KB of int cells
+
+    MortonLayout(int rows, int cols)
+        : tileBits(std::min({bitsFor(rows), bitsFor(cols), maxTileBits})),
+          tileMask((std::uint64_t{1} << tileBits) - 1),
+          tileRows(((rows - 1) >> tileBits) + 1), tileCols(((cols - 1) >> tileBits) + 1),
+          empty(rows == 0 || cols == 0) {}
+
+    std::size_t size() const {
+        return empty ? 0 : (static_cast<std::size_t>(tileRows) * tileCols) << (2 * tileBits);
+    }
+
+    // length of the side of a tile in cells
+    int getTileSize() const { return 1 << tileBits; }
+
+    std::size_t index(int row, int col) const {
+        std::size_t tile = static_cast<std::size_t>(row >> tileBits) * tileCols + (col >> tileBits);
+        std::uint64_t low = mortonEncode(static_cast<std::uint32_t>(row & tileMask),
+                                         static_cast<std::uint32_t>(col & tileMask));
+        return (tile << (2 * tileBits)) | static_cast<std::size_t>(low);
+    }
+
+private:
+    // number of bits needed for values 0..n-1
+    static int bitsFor(int n) {
+        int bits = 0;
+        while ((std::int64_t{1} << bits) < n) {
+            ++bits;
+        }
+        return bits;
+    }
+
+    int tileBits;
+    std::uint64_t tileMask;
+    int tileRows;
+    int tileCols;
+    bool empty;
+};
+
+TEST_CASE("Morton encode and decode") {
+    CHECK(mortonEncode(0, 0) == 0);
+    CHECK(mortonEncode(0, 1) == 1);
+    CHECK(mortonEncode(1, 0) == 2);
+    CHECK(mortonEncode(1, 1) == 3);
+    CHECK(mortonEncode(0, 2) == 4);
+    CHECK(mortonEncode(2, 0) == 8);
+    CHECK(mortonEncode(0xFFFFFFFFu, 0) == 0xAAAAAAAAAAAAAAAAull);
+
+    for (std::uint32_t row : {0u, 1u, 5u, 1000u, 65535u, 123456789u, 0xFFFFFFFFu}) {
+        for (std::uint32_t col : {0u, 3u, 77u, 4096u, 987654321u, 0xFFFFFFFFu}) {
+            std::uint64_t code = mortonEncode(row, col);
+            // hardware (BMI2) and portable versions give the same codes
+            CHECK(code == (spreadBitsPortable(col) | (spreadBitsPortable(row) << 1)));
+            CHECK(mortonDecode(code) == std::make_pair(row, col));
+        }
+    }
+}
+
+TEST_CASE("MortonLayout places every cell in its own slot") {
+    for (auto [rows, cols] : {std::pair<int, int>{8, 8}, {5, 3}, {3, 17}, {33, 4}, {1, 1}}) {
+        MortonLayout layout(rows, cols);
+        std::vector<bool> used(layout.size(), false);
+        for (int r = 0; r < rows; ++r) {
+            for (int c = 0; c < cols; ++c) {
+                std::size_t index = layout.index(r, c);
+                REQUIRE(index < layout.size());
+                CHECK(!used[index]);
+                used[index] = true;
+            }
+        }
+    }
+    CHECK(MortonLayout(0, 5).size() == 0);
+
+    // non-square and large grids are padded to whole tiles, not to powers of two
+    CHECK(MortonLayout(256, 4096).size() == std::size_t{256} * 4096);
+    CHECK(MortonLayout(1000, 1000).getTileSize() == 64);
+    CHECK(MortonLayout(1000, 1000).size() == std::size_t{1024} * 1024);
+    CHECK(MortonLayout(65, 4096).size() == std::size_t{128} * 4096);
+    CHECK(MortonLayout(3, 100).getTileSize() == 4);
+
+    // 2x2 blocks are contiguous: vertical neighbors are next to each other
+    MortonLayout square(4, 4);
+    CHECK(square.index(0, 0) == 0);
+    CHECK(square.index(0, 1) == 1);
+    CHECK(square.index(1, 0) == 2);
+    CHECK(square.index(1, 1) == 3);
+    CHECK(square.index(0, 2) == 4);
+}
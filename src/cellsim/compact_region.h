@@ -0,0 +1,288 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <utility>
+#include <vector>
+
+#include "../doctest.h"
+
+#include "region.h"
+#include "run_labeling.h"
+
+// Region stored as its bounding box and a list of runs of cells, one or more runs per row.
+// Solid or mostly solid regions take a few bytes per row instead of 8 bytes per cell.
+// Runs are kept in raster order, so cells are visited in the same row-major order as in Region.
+class CompactRegion {
+public:
+    // cells [colBegin, colEnd) of one row
+    struct Run {
+        int row;
+        int colBegin;
+        int colEnd;
+
+        int size() const { return colEnd - colBegin; }
+    };
+
+    // Forward iterator over cells of the region, gives (row, col) pairs in row-major order
+    class const_iterator {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = std::pair<int, int>;
+        using difference_type = std::ptrdiff_t;
+        using pointer = void;
+        using reference = value_type;
+
+        const_iterator() : run(nullptr), col(0) {}
+
+        value_type operator*() const { return {run->row, col}; }
+
+        const_iterator& operator++() {
+            if (++col == run->colEnd) {
+                ++run;
+                col = run->colBegin;
+            }
+            return *this;
+        }
+
+        const_iterator operator++(int) {
+            const_iterator previous = *this;
+            ++*this;
+            return previous;
+        }
+
+        bool operator==(const const_iterator& other) const { return run == other.run && col == other.col; }
+
+        bool operator!=(const const_iterator& other) const { return !(*this == other); }
+
+    private:
+        friend class CompactRegion;
+
+        const_iterator(const Run* run, int col) : run(run), col(col) {}
+
+        const Run* run;
+        int col;
+    };
+
+    CompactRegion() : top(0), left(0), bottom(-1), right(-1), cellCount(0) {}
+
+    // Same cells as region. Cells are expected in row-major order (as labeling gives them),
+    // otherwise they are sorted first. Repeated cells are counted once.
+    explicit CompactRegion(const Region& region) : CompactRegion() {
+        const auto& coordinates = region.getCoordinates();
+        if (std::is_sorted(coordinates.begin(), coordinates.end())) {
+            addSortedCells(coordinates);
+        } else {
+            std::vector<std::pair<int, int>> sorted = coordinates;
+            std::sort(sorted.begin(), sorted.end());
+            addSortedCells(sorted);
+        }
+    }
+
+    // Region from runs in raster order that do not overlap
+    explicit CompactRegion(std::vector<Run> runs) : CompactRegion() {
+        this->runs = std::move(runs);
+        for (const Run& run : this->runs) {
+            includeRun(run);
+        }
+        this->runs.push_back(Run{bottom + 1, 0, 0}); // end marker, see end()
+    }
+
+    bool empty() const { return cellCount == 0; }
+
+    // number of cells
+    std::size_t size() const { return cellCount; }
+
+    // bounding box, undefined for an empty region
+    int getTop() const { return top; }
+
+    int getLeft() const { return left; }
+
+    int getRows() const { return bottom - top + 1; }
+
+    int getCols() const { return right - left + 1; }
+
+    std::size_t getRunCount() const { return runs.empty() ? 0 : runs.size() - 1; }
+
+    const Run* runsBegin() const { return runs.data(); }
+
+    const Run* runsEnd() const { return runs.data() + getRunCount(); }
+
+    const_iterator begin() const {
+        return runs.empty() ? const_iterator() : const_iterator(runs.data(), runs.front().colBegin);
+    }
+
+    const_iterator end() const {
+        return runs.empty() ? const_iterator() : const_iterator(runsEnd(), runs.back().colBegin);
+    }
+
+    bool contains(int row, int col) const {
+        if (empty() || row < top || row > bottom || col < left || col > right) {
+            return false;
+        }
+        // first run that starts after the cell, the run before it is the only one that can hold the cell
+        const Run* after = std::upper_bound(runsBegin(), runsEnd(), std::make_pair(row, col),
+                                            [](const std::pair<int, int>& cell, const Run& run) {
+                                                return cell < std::make_pair(run.row, run.colBegin);
+                                            });
+        if (after == runsBegin()) {
+            return false;
+        }
+        const Run& run = *(after - 1);
+        return run.row == row && col < run.colEnd;
+    }
+
+    // Calls visit(row, col) for every cell in row-major order
+    template <typename Visitor>
+    void forEachCell(Visitor&& visit) const {
+        for (const Run* run = runsBegin(); run != runsEnd(); ++run) {
+            for (int c = run->colBegin; c < run->colEnd; ++c) {
+                visit(run->row, c);
+            }
+        }
+    }
+
+    // Region with the list of coordinates. Compact region has no values, so the descriptor
+    // counts every cell as a live cell of a bool grid (value 1).
+    Region toRegion() const {
+        Region region;
+        region.reserve(cellCount);
+        forEachCell([&](int row, int col) { region.addCell(row, col); });
+        return region;
+    }
+
+    // same, with values of the cells taken from cells of the grid
+    template <typename ValueT, typename Layout>
+    Region toRegion(const CellBuffer<ValueT, Layout>& cells) const {
+        Region region;
+        region.reserve(cellCount);
+        forEachCell([&](int row, int col) { region.addCell(row, col, static_cast<std::int64_t>(cells.getValue(row, col))); });
+        return region;
+    }
+
+    // number of bytes used by the region, including the object itself
+    std::size_t memoryBytes() const { return sizeof(*this) + runs.capacity() * sizeof(Run); }
+
+private:
+    void addSortedCells(const std::vector<std::pair<int, int>>& cells) {
+        for (const auto& [row, col] : cells) {
+            if (!runs.empty() && runs.back().row == row && runs.back().colEnd >= col) {
+                runs.back().colEnd = std::max(runs.back().colEnd, col + 1); // next cell of the run, or a repeated one
+                continue;
+            }
+            if (!runs.empty()) {
+                includeRun(runs.back());
+            }
+            runs.push_back(Run{row, col, col + 1});
+        }
+        if (!runs.empty()) {
+            includeRun(runs.back());
+            runs.push_back(Run{bottom + 1, 0, 0});
+        }
+        runs.shrink_to_fit();
+    }
+
+    // grows bounding box and cell count by the run
+    void includeRun(const Run& run) {
+        if (cellCount == 0) {
+            top = run.row;
+            left = run.colBegin;
+            bottom = run.row;
+            right = run.colEnd - 1;
+        } else {
+            top = std::min(top, run.row);
+            left = std::min(left, run.colBegin);
+            bottom = std::max(bottom, run.row);
+            right = std::max(right, run.colEnd - 1);
+        }
+        cellCount += run.size();
+    }
+
+    int top;
+    int left;
+    int bottom;
+    int right;
+    std::size_t cellCount;
+    std::vector<Run> runs; // raster order, followed by an empty end marker run when not empty
+};
+
+// compact regions straight from the runs, without listing every cell
+inline std::vector<CompactRegion> toCompactRegions(const RunRegions& regions) {
+    std::vector<std::vector<CompactRegion::Run>> runs(regions.regionCount);
+    for (const CellRun& run : regions.runs) {
+        runs[run.label - 1].push_back(CompactRegion::Run{run.row, run.colBegin, run.colEnd});
+    }
+    std::vector<CompactRegion> result;
+    result.reserve(regions.regionCount);
+    for (auto& regionRuns : runs) {
+        result.emplace_back(std::move(regionRuns));
+    }
+    return result;
+}
+
+TEST_CASE("CompactRegion keeps cells of Region") {
+    Region region;
+    for (auto [row, col] : {std::pair<int, int>{2, 5}, {2, 6}, {2, 7}, {2, 9}, {3, 4}, {5, 8}}) {
+        region.addCell(row, col);
+    }
+    CompactRegion compact(region);
+    CHECK(compact.size() == 6);
+    CHECK(compact.getRunCount() == 4);
+    CHECK(compact.getTop() == 2);
+    CHECK(compact.getLeft() == 4);
+    CHECK(compact.getRows() == 4);
+    CHECK(compact.getCols() == 6);
+    CHECK(compact.toRegion().getCoordinates() == region.getCoordinates());
+    CHECK(std::vector<std::pair<int, int>>(compact.begin(), compact.end()) == region.getCoordinates());
+    CHECK(compact.contains(2, 7));
+    CHECK(!compact.contains(2, 8));
+    CHECK(!compact.contains(4, 5));
+    CHECK(compact.contains(5, 8));
+
+    Region unordered;
+    for (auto [row, col] : {std::pair<int, int>{5, 8}, {2, 6}, {3, 4}, {2, 5}, {2, 9}, {2, 7}, {2, 6}}) {
+        unordered.addCell(row, col);
+    }
+    CHECK(CompactRegion(unordered).toRegion().getCoordinates() == region.getCoordinates());
+
+    CompactRegion empty{Region()};
+    CHECK(empty.empty());
+    CHECK(empty.begin() == empty.end());
+    CHECK(!empty.contains(0, 0));
+}
+
+TEST_CASE("CompactRegion of a solid region is small") {
+    Region region;
+    for (int r = 0; r < 100; ++r) {
+        for (int c = 0; c < 100; ++c) {
+            region.addCell(r, c);
+        }
+    }
+    CompactRegion compact(region);
+    CHECK(compact.size() == 10000);
+    CHECK(compact.memoryBytes() * 20 < region.size() * sizeof(region.getCoordinates()[0]));
+}
+
+TEST_CASE("compact regions from run-length labeling") {
+    CellBuffer<bool> cells(29, 97);
+    std::mt19937 random(7);
+    std::bernoulli_distribution alive(0.45);
+    for (int r = 0; r < 29; ++r) {
+        for (int c = 0; c < 97; ++c) {
+            cells.setValue(r, c, alive(random));
+        }
+    }
+    RunRegions runs = RunLengthLabeler().label(cells);
+    std::vector<Region> expected = runs.toRegions();
+    std::vector<CompactRegion> regions = toCompactRegions(runs);
+    REQUIRE(regions.size() == expected.size());
+    bool regionsMatch = true;
+    for (std::size_t i = 0; i < regions.size(); ++i) {
+        regionsMatch = regionsMatch && regions[i].toRegion().getCoordinates() == expected[i].getCoordinates()
+                       && regions[i].toRegion(cells).getDescriptor().getContentHash()
+                              == expected[i].getDescriptor().getContentHash();
+    }
+    CHECK(regionsMatch);
+}
@@ -0,0 +1,255 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+#include <vector>
+
+#include "../doctest.h"
+
+#include "grid.h"
+#include "grid_allocator.h"
+#include "neighborhood.h"
+#include "parallel.h"
+
+// Distance from every cell of a grid to the nearest live (non-zero) cell.
+// For Euclidean distance the map keeps squared distances, so all values are exact integers.
+class DistanceMap {
+public:
+    // distance of every cell when the grid has no live cells
+    static constexpr std::int64_t unreachable = std::numeric_limits<std::int64_t>::max();
+
+    DistanceMap() : rows(0), cols(0), distanceType(DistanceType::Euclidean) {}
+
+    DistanceMap(int rows, int cols, DistanceType distanceType)
+        : rows(rows), cols(cols), distanceType(distanceType),
+          distances(static_cast<std::size_t>(rows) * cols, unreachable) {}
+
+    int getRows() const { return rows; }
+
+    int getCols() const { return cols; }
+
+    DistanceType getDistanceType() const { return distanceType; }
+
+    // squared distance for DistanceType::Euclidean
+    std::int64_t getDistance(int row, int col) const {
+        if (row < 0 || row >= rows || col < 0 || col >= cols) {
+            throw std::out_of_range("Cell index out of range");
+        }
+        return distances[static_cast<std::size_t>(row) * cols + col];
+    }
+
+private:
+    friend class DistanceTransform;
+
+    int rows;
+    int cols;
+    DistanceType distanceType;
+    std::vector<std::int64_t> distances; // row-major order
+};
+
+// Exact distance transform in O(rows * cols) with two separable passes (Meijster, Roerdink and Hesselink, 2000):
+// 1. for every column, distance to the nearest live cell in the same column (scan down, then up);
+// 2. for every row, the lower envelope of functions f(col, i) built from the column distances of step 1,
+//    found with a stack of segments, gives the distance to the nearest live cell in the whole grid.
+// Columns of pass 1 and rows of pass 2 are independent, so each pass is split between threads.
+// Pass 1 still goes along rows: every thread owns a range of columns that is made of whole cache lines
+// of the column distances, and sweeps it row by row, so cells are read in storage order and
+// no two threads write to the same cache line.
+class DistanceTransform {
+public:
+    explicit DistanceTransform(int threadCount = 1) : threadCount(std::max(1, threadCount)) {}
+
+    template <typename ValueT, typename Layout>
+    DistanceMap compute(const BasicGrid<ValueT, Layout>& grid, DistanceType distanceType) const {
+        const CellBuffer<ValueT, Layout>& cells = grid.getCells();
+        int rows = grid.getRows();
+        int cols = grid.getCols();
+        DistanceMap map(rows, cols, distanceType);
+        if (rows == 0 || cols == 0) {
+            return map;
+        }
+        // larger than any real distance along a column or row, but small enough to square it
+        const std::int64_t infinity = static_cast<std::int64_t>(rows) + cols;
+
+        // pass 1: columnDistances[r * stride + c] is distance from (r, c) to the nearest live cell of column c;
+        // rows are padded to whole cache lines, and the array starts at a cache line (see GridAllocator)
+        constexpr int lineColumns = static_cast<int>(GridAllocator<std::int64_t>::alignment / sizeof(std::int64_t));
+        int lineCount = (cols + lineColumns - 1) / lineColumns;
+        std::size_t stride = static_cast<std::size_t>(lineCount) * lineColumns;
+        GridArray<std::int64_t> columnDistances(rows * stride);
+        std::vector<char> threadFoundLiveCell(threadCount, false); // written once by each thread
+        parallelFor(0, lineCount, threadCount, [&](int worker, int lineBegin, int lineEnd) {
+            int colBegin = lineBegin * lineColumns;
+            int colEnd = std::min(cols, lineEnd * lineColumns);
+            bool foundLiveCell = false;
+            // scan down: distance to the nearest live cell above or at the cell
+            for (int r = 0; r < rows; ++r) {
+                std::int64_t* current = columnDistances.data() + r * stride;
+                const std::int64_t* above = r == 0 ? current : current - stride;
+                for (int c = colBegin; c < colEnd; ++c) {
+                    bool isLive = cells.getValue(r, c) != 0;
+                    foundLiveCell = foundLiveCell || isLive;
+                    current[c] = isLive ? 0 : r == 0 ? infinity : std::min(above[c] + 1, infinity);
+                }
+            }
+            // scan up: nearest live cell below
+            for (int r = rows - 2; r >= 0; --r) {
+                std::int64_t* current = columnDistances.data() + r * stride;
+                const std::int64_t* below = current + stride;
+                for (int c = colBegin; c < colEnd; ++c) {
+                    current[c] = std::min(current[c], below[c] + 1);
+                }
+            }
+            threadFoundLiveCell[worker] = foundLiveCell;
+        });
+        if (std::find(threadFoundLiveCell.begin(), threadFoundLiveCell.end(), true) == threadFoundLiveCell.end()) {
+            return map; // all cells stay unreachable
+        }
+
+        // pass 2: lower envelope along every row
+        parallelFor(0, rows, threadCount, [&](int, int rowBegin, int rowEnd) {
+            std::vector<int> starts(cols);   // column of function of each segment
+            std::vector<std::int64_t> bounds(cols); // first column where segment is the lowest
+            for (int r = rowBegin; r < rowEnd; ++r) {
+                const std::int64_t* g = columnDistances.data() + r * stride;
+                std::int64_t* result = map.distances.data() + static_cast<std::size_t>(r) * cols;
+                switch (distanceType) {
+                    case DistanceType::Euclidean:
+                        envelope(g, cols, infinity, result, starts, bounds,
+                                 [](std::int64_t x, std::int64_t i, std::int64_t gi) { return (x - i) * (x - i) + gi * gi; },
+                                 [](std::int64_t i, std::int64_t u, std::int64_t gi, std::int64_t gu, std::int64_t) {
+                                     return floorDivide(u * u - i * i + gu * gu - gi * gi, 2 * (u - i));
+                                 });
+                        break;
+                    case DistanceType::Manhattan:
+                        envelope(g, cols, infinity, result, starts, bounds,
+                                 [](std::int64_t x, std::int64_t i, std::int64_t gi) { return std::abs(x - i) + gi; },
+                                 [](std::int64_t i, std::int64_t u, std::int64_t gi, std::int64_t gu, std::int64_t inf) {
+                                     if (gu >= gi + u - i) {
+                                         return inf;
+                                     }
+                                     if (gi > gu + u - i) {
+                                         return -inf;
+                                     }
+                                     return floorDivide(gu - gi + u + i, 2);
+                                 });
+                        break;
+                    case DistanceType::Chebyshev:
+                        envelope(g, cols, infinity, result, starts, bounds,
+                                 [](std::int64_t x, std::int64_t i, std::int64_t gi) { return std::max(std::abs(x - i), gi); },
+                                 [](std::int64_t i, std::int64_t u, std::int64_t gi, std::int64_t gu, std::int64_t) {
+                                     if (gi <= gu) {
+                                         return std::max(i + gu, floorDivide(i + u, 2));
+                                     }
+                                     return std::min(u - gi, floorDivide(i + u, 2));
+                                 });
+                        break;
+                }
+            }
+        });
+        return map;
+    }
+
+private:
+    static std::int64_t floorDivide(std::int64_t numerator, std::int64_t denominator) {
+        std::int64_t quotient = numerator / denominator;
+        return (numerator % denominator != 0 && (numerator < 0) != (denominator < 0)) ? quotient - 1 : quotient;
+    }
+
+    // Distances of one row: result[x] = min over i of f(x, i, g[i]).
+    // separator(i, u, ...) is the last x where function of column i is not above function of column u (i < u).
+    template <typename Function, typename Separator>
+    static void envelope(const std::int64_t* g, int cols, std::int64_t infinity, std::int64_t* result,
+                         std::vector<int>& starts, std::vector<std::int64_t>& bounds,
+                         Function f, Separator separator) {
+        int top = 0;
+        starts[0] = 0;
+        bounds[0] = 0;
+        for (int u = 1; u < cols; ++u) {
+            while (top >= 0 && f(bounds[top], starts[top], g[starts[top]]) > f(bounds[top], u, g[u])) {
+                top--;
+            }
+            if (top < 0) {
+                top = 0;
+                starts[0] = u;
+            } else {
+                std::int64_t bound = 1 + separator(starts[top], u, g[starts[top]], g[u], infinity);
+                if (bound < cols) {
+                    top++;
+                    starts[top] = u;
+                    bounds[top] = bound;
+                }
+            }
+        }
+        for (int x = cols - 1; x >= 0; --x) {
+            result[x] = f(x, starts[top], g[starts[top]]);
+            if (x == bounds[top]) {
+                top--;
+            }
+        }
+    }
+
+    int threadCount;
+};
+
+// distance from every cell to the nearest live cell (squared for Euclidean distance)
+template <typename ValueT, typename Layout>
+DistanceMap computeDistanceMap(const BasicGrid<ValueT, Layout>& grid, DistanceType distanceType, int threadCount = 1) {
+    return DistanceTransform(threadCount).compute(grid, distanceType);
+}
+
+TEST_CASE("distance transform matches brute force") {
+    for (double density : {0.01, 0.1, 0.5}) {
+        Grid grid(23, 31);
+        grid.fillGridWithRandomValues({0, 1}, {1.0 - density, density});
+
+        std::vector<std::pair<int, int>> live;
+        for (int r = 0; r < 23; ++r) {
+            for (int c = 0; c < 31; ++c) {
+                if (grid.getCellValue(r, c) != 0) {
+                    live.emplace_back(r, c);
+                }
+            }
+        }
+
+        for (DistanceType type : {DistanceType::Euclidean, DistanceType::Manhattan, DistanceType::Chebyshev}) {
+            for (int threadCount : {1, 4}) {
+                DistanceMap map = computeDistanceMap(grid, type, threadCount);
+                bool allMatch = true;
+                for (int r = 0; r < 23; ++r) {
+                    for (int c = 0; c < 31; ++c) {
+                        std::int64_t expected = DistanceMap::unreachable;
+                        for (const auto& [liveRow, liveCol] : live) {
+                            std::int64_t dr = std::abs(r - liveRow);
+                            std::int64_t dc = std::abs(c - liveCol);
+                            std::int64_t distance = type == DistanceType::Euclidean ? dr * dr + dc * dc
+                                                  : type == DistanceType::Manhattan ? dr + dc
+                                                  : std::max(dr, dc);
+                            expected = std::min(expected, distance);
+                        }
+                        allMatch = allMatch && map.getDistance(r, c) == expected;
+                    }
+                }
+                CHECK(allMatch);
+            }
+        }
+    }
+}
+
+TEST_CASE("distance transform of special grids") {
+    Grid empty(3, 4);
+    DistanceMap emptyMap = computeDistanceMap(empty, DistanceType::Manhattan);
+    CHECK(emptyMap.getDistance(1, 1) == DistanceMap::unreachable);
+
+    Grid single(1, 5);
+    single.setCellValue(0, 4, 1);
+    DistanceMap rowMap = computeDistanceMap(single, DistanceType::Euclidean);
+    CHECK(rowMap.getDistance(0, 0) == 16);
+    CHECK(rowMap.getDistance(0, 4) == 0);
+    CHECK_THROWS_AS(rowMap.getDistance(1, 0), std::out_of_range);
+
+    Grid none(0, 0);
+    CHECK(computeDistanceMap(none, DistanceType::Chebyshev).getRows() == 0);
+}
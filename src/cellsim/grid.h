@@ -4,8 +4,11 @@
 #include <vector>
 #include <stack>
 #include <set>
+#include <iomanip>
+#include <cstdint>
 
 #include <random>
+#include <type_traits>
 
 
 #include <cassert>
@@ -14,83 +17,125 @@
 
 #include "helper.h"
 #include "cell.h"
+#include "cell_buffer.h"
+#include "grid_snapshot.h"
+#include "parallel_update.h"
 #include "update.h"
+#include "region.h"
+#include "region_labeling.h"
+#include "run_labeling.h"
+#include "interaction_labeling.h"
 
 
 
-
-class Region {
-public:
-    std::vector<std::pair<int, int>> coordinates;
-
-    void addCell(int row, int col) {
-        coordinates.emplace_back(row, col);
+// Grid of cells with values of type ValueT.
+// Grid (int values) is the default, ByteGrid and BitGrid (bit-packed) are for automata
+// with few states, they use 4 and 32 times less memory.
+// Layout defines how cells are placed in memory (see cell_layout.h), for example
+// BasicGrid<int, MortonLayout> keeps cells in Z-order.
+template <typename ValueT = int, typename Layout = RowMajorLayout>
+class BasicGrid {
+private:
+    CellBuffer<ValueT, Layout> cells;
+    // Engines have no per-grid state, so they are shared by all grids instead of being stored
+    // in each of them. This keeps grid small and lets it use default copy and move operations.
+    static inline const Updater updater{};
+
+    // calculator holds only the dimensions and reads stencils from a shared table without locking,
+    // so making one for every query costs two ints
+    NeighborhoodCalculator makeNeighborhoodCalculator() const { // Neighborhood logic
+        return NeighborhoodCalculator(getRows(), getCols());
     }
-};
 
+template <typename V, typename L>
+friend BasicGrid<V, L> convertRegionToGrid(const BasicGrid<V, L>& originalGrid, const Region& region);
 
+public:
+    using ValueType = ValueT;
+    using LayoutType = Layout;
+    using CellReference = typename CellBuffer<ValueT, Layout>::reference;
+    using ConstCellReference = typename CellBuffer<ValueT, Layout>::const_reference;
 
-class Grid {
-private:
-    int rows;
-    int cols;
-    std::vector<std::vector<Cell>> cells;
-    NeighborhoodCalculator neighborhoodCalculator; // Neighborhood logic
-    Updater updater;
-
-friend Grid convertRegionToGrid(const Grid& originalGrid, const Region& region);
+    BasicGrid(int rows, int cols) : cells(rows, cols) {
+    }
 
-public:
-    Grid(int rows, int cols) : rows(rows), cols(cols), 
-                                neighborhoodCalculator{rows, cols}, updater{neighborhoodCalculator} {
-        // Initialize the 2D vector with Cell objects
-        cells.resize(rows, std::vector<Cell>(cols));
+    // grid that takes ownership of the given cells
+    explicit BasicGrid(CellBuffer<ValueT, Layout> cells) : cells(std::move(cells)) {
     }
 
-    Grid(const Grid& other) : rows(other.rows), cols(other.cols), 
-                                neighborhoodCalculator{rows, cols}, updater{neighborhoodCalculator} {
-        cells = other.cells;                            
+    // grid with cells restored from snapshot
+    explicit BasicGrid(const GridSnapshot<ValueT>& snapshot) : cells(snapshot.template toCells<Layout>()) {
     }
 
     bool isValidCoordinates(int row, int col) const {
-        if (row < 0 || row >= rows || col < 0 || col >= cols) {
+        if (row < 0 || row >= getRows() || col < 0 || col >= getCols()) {
             return false;
         } 
         return true;
     }
 
-    Cell& getCell(int row, int col) {
+    CellReference getCell(int row, int col) {
         // Add bounds checking
         if (!isValidCoordinates(row,col)) {
             throw std::out_of_range("Cell index out of range");
         }
-        return cells[row][col];
+        return cells.at(row, col);
     }
 
-    const Cell& getCell(int row, int col) const {
+    ConstCellReference getCell(int row, int col) const {
         // Add bounds checking
         if (!isValidCoordinates(row,col)) {
             throw std::out_of_range("Cell index out of range");
         }
-        return cells[row][col];
+        return cells.at(row, col);
     }
 
-    void setCellValue(int row, int col, int value) {
+    void setCellValue(int row, int col, ValueT value) {
         getCell(row, col).setValue(value);
     }
 
-    int getCellValue(int row, int col) const {
+    ValueT getCellValue(int row, int col) const {
         return getCell(row, col).getValue();
     }
 
-    int getRows() const { return rows;}
+    int getRows() const { return cells.getRows();}
+
+    int getCols() const { return cells.getCols();}
 
-    int getCols() const { return cols;}
+    // cell storage, for algorithms that work with the whole grid at once
+    const CellBuffer<ValueT, Layout>& getCells() const { return cells; }
+
+    // number of bytes used to store cell values
+    std::size_t memoryBytes() const { return cells.memoryBytes(); }
+
+    // Immutable copy of the current cells. If previous snapshot of this grid is given,
+    // tiles that did not change since then are shared with it instead of being copied.
+    GridSnapshot<ValueT> snapshot(const GridSnapshot<ValueT>& previous = GridSnapshot<ValueT>()) const {
+        return GridSnapshot<ValueT>::capture(cells, previous);
+    }
+
+    void restore(const GridSnapshot<ValueT>& snapshot) {
+        cells = snapshot.template toCells<Layout>();
+    }
 
     // Function to calculate the neighborhood based on distance type and distance
     std::vector<std::pair<int, int>>getNeighborhoodByDistance(int row, int col,
                                                 DistanceType distanceType, int distance) const {
-        return neighborhoodCalculator.getNeighborhoodByDistance(row, col, distanceType, distance);
+        return makeNeighborhoodCalculator().getNeighborhoodByDistance(row, col, distanceType, distance);
+    }
+
+    // Calls visit(row, col) for every cell of the neighborhood without building a vector of cells
+    // (distances above NeighborhoodStencils::maxDistance build their stencil on every call)
+    template <typename Visitor>
+    void forEachInNeighborhood(int row, int col, DistanceType distanceType, int distance, Visitor&& visit) const {
+        makeNeighborhoodCalculator().forEachInNeighborhood(row, col, distanceType, distance,
+                                                           std::forward<Visitor>(visit));
+    }
+
+    // Neighborhoods of many cells in one structure (see NeighborhoodCalculator::getNeighborhoods)
+    NeighborhoodLists getNeighborhoods(const std::vector<std::pair<int, int>>& centers, DistanceType distanceType,
+                                       int distance, int threadCount = 1) const {
+        return makeNeighborhoodCalculator().getNeighborhoods(centers, distanceType, distance, threadCount);
     }
 
     // std::vector<std::pair<int, int>> getNeighbors(int row, int col) const {
@@ -99,13 +144,43 @@ public:
 
     // returns true if next state is different from previous state, false if they are the same
     bool update() {
-        std::vector<std::vector<Cell>> newCells = updater.update(cells); // Copy current state
+        return update(updater);
+    }
+
+    // same as update(), but cells outside the grid are treated as boundary mode of the given updater says,
+    // for example grid.update(Updater(BoundaryMode::Toroidal))
+    bool update(const Updater& boundaryUpdater) {
+        CellBuffer<ValueT, Layout> newCells = boundaryUpdater.update(cells); // Copy current state
 
         if (cells == newCells) {
            return false;
         }
 
-        cells = newCells; // Update to new state
+        cells = std::move(newCells); // Update to new state
+        return true;
+    }
+
+    // same as update(), but computed by several threads (see ParallelUpdater)
+    bool update(ParallelUpdater& parallelUpdater) {
+        CellBuffer<ValueT, Layout> newCells(getRows(), getCols()); // large buffers are not touched yet, workers place them in their memory
+        if (!parallelUpdater.update(cells, newCells)) {
+           return false;
+        }
+
+        cells = std::move(newCells);
+        return true;
+    }
+
+    // same as update(), but also reports which cells changed (in row-major order)
+    bool update(std::vector<CellChange<ValueT>>& changes) {
+        changes.clear();
+        CellBuffer<ValueT, Layout> newCells = updater.update(cells, &changes);
+
+        if (changes.empty()) {
+           return false;
+        }
+
+        cells = std::move(newCells);
         return true;
     }
 
@@ -133,8 +208,8 @@ public:
         }
 
         // Fill the grid
-        for (auto& row : cells) {
-            for (auto& cell : row) {
+        for (int r = 0; r < getRows(); ++r) {
+            for (int c = 0; c < getCols(); ++c) {
                 double randomValue = dis(gen);
                 int valueToSet = values.back(); // Default to last value
                 
@@ -145,56 +220,38 @@ public:
                     }
                 }
 
-                cell.setValue(valueToSet);
+                cells.setValue(r, c, static_cast<ValueT>(valueToSet));
             }
         }
     }
 
-    void findRegions(int startX, int startY, std::vector<std::vector<bool>>& visited,
-                     Region& region) {
-        std::stack<std::pair<int, int>> stack;
-        stack.push({startX, startY});
-        visited[startX][startY] = true;
-        region.addCell(startX, startY); // Add starting cell to the region
-
-        while (!stack.empty()) {
-            auto [x, y] = stack.top();
-            stack.pop();
-
-            for (const auto& neighbor : neighborhoodCalculator.getNeighbors(x, y)) {
-                int newX = neighbor.first;
-                int newY = neighbor.second;
-
-                if (cells[newX][newY].getValue() != 0 && !visited[newX][newY]) { // Check if the neighbor is alive (non-zero)
-                    visited[newX][newY] = true;
-                    region.addCell(newX, newY); // Add to the region
-                    stack.push({newX, newY});
-                }
-            }
+    // Groups of live (non-zero) cells connected through their 8 neighbors, ordered by their first cell
+    // in row-major order (see RegionLabeler)
+    // (bit-packed grids are labeled by runs of live cells, see RunLengthLabeler)
+    std::vector<Region> getNonInteractingRegions() const {
+        if constexpr (std::is_same_v<CellBuffer<ValueT, Layout>, CellBuffer<bool>>) {
+            return RunLengthLabeler().getRegions(cells);
+        } else {
+            return RegionLabeler().getRegions(cells);
         }
     }
 
-    std::vector<Region> getNonInteractingRegions() {
-        std::vector<Region> regions;
-        std::vector<std::vector<bool>> visited(rows, std::vector<bool>(cols, false));
-
-        for (int i = 0; i < rows; ++i) {
-            for (int j = 0; j < cols; ++j) {
-                if (cells[i][j].getValue() != 0 && !visited[i][j]) { // Check if the cell is "alive" (non-zero value)
-                    Region region;
-                    findRegions(i, j, visited, region);
-                    regions.push_back(region);
-                }
-            }
-        }
+    // same regions, found by several threads (see ParallelRegionLabeler)
+    std::vector<Region> getNonInteractingRegions(int threadCount) const {
+        return ParallelRegionLabeler(threadCount).getRegions(cells);
+    }
 
-        return regions;
+    // Groups of live cells joined when they are at most interactionDistance cells apart in any direction,
+    // for rules that reach further than the 8 neighbors (see InteractionRegionLabeler).
+    // Distance 1 gives the same regions as getNonInteractingRegions().
+    std::vector<Region> getNonInteractingRegionsWithin(int interactionDistance) const {
+        return InteractionRegionLabeler(interactionDistance).getRegions(cells);
     }
 
     void printGrid() const {
-        for (const auto& row : cells) {
-            for (const auto& cell : row) {
-                std::cout << cell.getValue() << " ";
+        for (int r = 0; r < getRows(); ++r) {
+            for (int c = 0; c < getCols(); ++c) {
+                std::cout << toPrintableValue(cells.getValue(r, c)) << " ";
             }
             std::cout << std::endl;
         }
@@ -207,13 +264,13 @@ void printGridWithNeighborhood(const std::vector<std::pair<int, int>>& neighborh
     std::set<std::pair<int, int>> neighborhoodSet(neighborhoodCoords.begin(), neighborhoodCoords.end());
 
     // Print the grid
-    for (size_t r = 0; r < rows; ++r) {
-        for (size_t c = 0; c < cols; ++c) {
+    for (int r = 0; r < getRows(); ++r) {
+        for (int c = 0; c < getCols(); ++c) {
             // Check if the current cell is in the neighborhood
-            if (neighborhoodSet.find({static_cast<int>(r), static_cast<int>(c)}) != neighborhoodSet.end()) {
+            if (neighborhoodSet.find({r, c}) != neighborhoodSet.end()) {
                 std::cout << mark; // Mark the neighborhood cell
             } else {
-                std::cout << cells[r][c].getValue(); // Print the normal cell value
+                std::cout << toPrintableValue(cells.getValue(r, c)); // Print the normal cell value
             }
         }
         std::cout << std::endl; // New line after each row
@@ -222,9 +279,9 @@ void printGridWithNeighborhood(const std::vector<std::pair<int, int>>& neighborh
 
     std::string gridToString() const {
         std::string result;
-        for (const auto& row : cells) {
-            for (const auto& cell : row) {
-                result += std::to_string(cell.getValue()) + " ";
+        for (int r = 0; r < getRows(); ++r) {
+            for (int c = 0; c < getCols(); ++c) {
+                result += std::to_string(toPrintableValue(cells.getValue(r, c))) + " ";
             }
             result += "\n";
         }
@@ -232,11 +289,11 @@ void printGridWithNeighborhood(const std::vector<std::pair<int, int>>& neighborh
     }
 
     void printRegions(const std::vector<Region>& regions) {
-        std::vector<std::vector<char>> regionGrid(rows, std::vector<char>(cols, '.'));
+        std::vector<std::vector<char>> regionGrid(getRows(), std::vector<char>(getCols(), '.'));
 
         char regionChar = 'A';
         for (const auto& region : regions) {
-            for (const auto& cell : region.coordinates) {
+            for (const auto& cell : region.getCoordinates()) {
                 regionGrid[cell.first][cell.second] = regionChar; // Mark the region
             }
             regionChar++; // Move to the next character
@@ -254,6 +311,10 @@ void printGridWithNeighborhood(const std::vector<std::pair<int, int>>& neighborh
 
 };
 
+using Grid = BasicGrid<int>;
+using ByteGrid = BasicGrid<std::uint8_t>;
+using BitGrid = BasicGrid<bool>;
+
 TEST_CASE("Grid initialization and value setting") {
     Grid grid(3, 3);  // Create a 3x3 grid
 
@@ -428,13 +489,94 @@ TEST_CASE("block is still life") {
 
 }
 
+TEST_CASE("toroidal boundary wraps blinker around edges") {
+    Grid grid(5, 5);
+    // horizontal blinker that crosses left and right edges
+    grid.setCellValue(2, 4, 1);
+    grid.setCellValue(2, 0, 1);
+    grid.setCellValue(2, 1, 1);
+    Grid deadEdges = grid;
+
+    CHECK(grid.update(Updater(BoundaryMode::Toroidal)));
+    CHECK(grid.getCellValue(1, 0) == 1);
+    CHECK(grid.getCellValue(2, 0) == 1);
+    CHECK(grid.getCellValue(3, 0) == 1);
+    CHECK(grid.getCellValue(2, 4) == 0);
+    CHECK(grid.getCellValue(2, 1) == 0);
+
+    // without wrapping the same cells are two separate pieces that die
+    CHECK(deadEdges.update());
+    CHECK(deadEdges.gridToString() == Grid(5, 5).gridToString());
+}
+
+TEST_CASE("reflective boundary mirrors edge cells") {
+    Grid grid(4, 4);
+    // with its mirror image above the top edge this domino is a block
+    grid.setCellValue(0, 1, 1);
+    grid.setCellValue(0, 2, 1);
+    Grid deadEdges = grid;
+
+    CHECK(!grid.update(Updater(BoundaryMode::Reflective)));
+    CHECK(grid.getCellValue(0, 1) == 1);
+    CHECK(grid.getCellValue(0, 2) == 1);
+
+    CHECK(deadEdges.update());
+    CHECK(deadEdges.getCellValue(0, 1) == 0);
+}
+
+TEST_CASE("boundary modes match direct neighbor counting") {
+    const int rows = 7;
+    const int cols = 9;
+    for (BoundaryMode mode : {BoundaryMode::Dead, BoundaryMode::Toroidal, BoundaryMode::Reflective}) {
+        ByteGrid grid(rows, cols);
+        for (int r = 0; r < rows; ++r) {
+            for (int c = 0; c < cols; ++c) {
+                grid.setCellValue(r, c, (r * 5 + c * 3) % 7 < 3);
+            }
+        }
+        ByteGrid parallelGrid = grid;
+        ParallelUpdater parallelUpdater(3, mode);
+
+        for (int generation = 0; generation < 5; ++generation) {
+            // next generation computed by mapping every neighbor position to the cell it refers to
+            ByteGrid expected(rows, cols);
+            for (int r = 0; r < rows; ++r) {
+                for (int c = 0; c < cols; ++c) {
+                    int alive = 0;
+                    for (int dr = -1; dr <= 1; ++dr) {
+                        for (int dc = -1; dc <= 1; ++dc) {
+                            int nr = r + dr;
+                            int nc = c + dc;
+                            if (mode == BoundaryMode::Toroidal) {
+                                nr = (nr + rows) % rows;
+                                nc = (nc + cols) % cols;
+                            } else if (mode == BoundaryMode::Reflective) {
+                                nr = std::clamp(nr, 0, rows - 1);
+                                nc = std::clamp(nc, 0, cols - 1);
+                            }
+                            alive += grid.isValidCoordinates(nr, nc) && grid.getCellValue(nr, nc) == 1;
+                        }
+                    }
+                    bool isAlive = grid.getCellValue(r, c) == 1;
+                    expected.setCellValue(r, c, isAlive ? (alive == 3 || alive == 4) : alive == 3);
+                }
+            }
+
+            grid.update(Updater(mode));
+            parallelGrid.update(parallelUpdater);
+            CHECK(grid.gridToString() == expected.gridToString());
+            CHECK(parallelGrid.gridToString() == expected.gridToString());
+        }
+    }
+}
+
 TEST_CASE("Test Single Live Cell") {
     Grid grid(3, 3);
     grid.setCellValue(1, 1, 1); // Set a non-zero value
     auto regions = grid.getNonInteractingRegions();
     CHECK(regions.size() == 1);
-    CHECK(regions[0].coordinates.size() == 1);
-    CHECK(regions[0].coordinates[0] == std::make_pair(1, 1));
+    CHECK(regions[0].size() == 1);
+    CHECK(regions[0].getCoordinates()[0] == std::make_pair(1, 1));
 }
 
 TEST_CASE("Test Two Separate Regions") {
@@ -448,10 +590,10 @@ TEST_CASE("Test Two Separate Regions") {
 
     auto regions = grid.getNonInteractingRegions();
     CHECK(regions.size() == 2);
-    CHECK(regions[0].coordinates.size() == 3); // First region (3 cells)
-    CHECK(regions[1].coordinates.size() == 2); // Second region (2 cells)
-    CHECK(regions[0].coordinates[0] == std::make_pair(0, 1));
-    CHECK(regions[1].coordinates[0] == std::make_pair(2, 3));
+    CHECK(regions[0].size() == 3); // First region (3 cells)
+    CHECK(regions[1].size() == 2); // Second region (2 cells)
+    CHECK(regions[0].getCoordinates()[0] == std::make_pair(0, 1));
+    CHECK(regions[1].getCoordinates()[0] == std::make_pair(2, 3));
 }
 
 TEST_CASE("Test Entire Grid is Alive") {
@@ -463,7 +605,7 @@ TEST_CASE("Test Entire Grid is Alive") {
 
     auto regions = grid.getNonInteractingRegions();
     CHECK(regions.size() == 1);
-    CHECK(regions[0].coordinates.size() == 4); // All cells are "alive"
+    CHECK(regions[0].size() == 4); // All cells are "alive"
 }
 
 TEST_CASE("Test No Live Cells") {
@@ -472,13 +614,76 @@ TEST_CASE("Test No Live Cells") {
     CHECK(regions.size() == 0); // No regions
 }
 
-Grid convertRegionToGrid(const Grid& originalGrid, const Region& region) {
+TEST_CASE("labeled regions are the same as regions found by flood fill") {
+    for (double density : {0.2, 0.45, 0.7}) {
+        Grid grid(40, 60);
+        grid.fillGridWithRandomValues({0, 1}, {1.0 - density, density});
+
+        // depth-first flood fill from the first cell of every region
+        std::vector<Region> floodFilled;
+        std::vector<std::vector<bool>> visited(40, std::vector<bool>(60, false));
+        for (int r = 0; r < 40; ++r) {
+            for (int c = 0; c < 60; ++c) {
+                if (grid.getCellValue(r, c) == 0 || visited[r][c]) {
+                    continue;
+                }
+                Region& region = floodFilled.emplace_back();
+                std::stack<std::pair<int, int>> stack;
+                stack.push({r, c});
+                visited[r][c] = true;
+                region.addCell(r, c, grid.getCellValue(r, c));
+                while (!stack.empty()) {
+                    auto [row, col] = stack.top();
+                    stack.pop();
+                    grid.forEachInNeighborhood(row, col, DistanceType::Chebyshev, 1, [&](int newRow, int newCol) {
+                        if (grid.getCellValue(newRow, newCol) != 0 && !visited[newRow][newCol]) {
+                            visited[newRow][newCol] = true;
+                            region.addCell(newRow, newCol, grid.getCellValue(newRow, newCol));
+                            stack.push({newRow, newCol});
+                        }
+                    });
+                }
+            }
+        }
+
+        std::vector<Region> labeled = grid.getNonInteractingRegions();
+        REQUIRE(labeled.size() == floodFilled.size());
+        bool regionsMatch = true;
+        for (std::size_t i = 0; i < labeled.size(); ++i) {
+            auto expected = floodFilled[i].getCoordinates();
+            std::sort(expected.begin(), expected.end()); // flood fill lists cells in the order it reached them
+            regionsMatch = regionsMatch && labeled[i].getCoordinates() == expected;
+            // hash does not depend on the order in which cells were found
+            regionsMatch = regionsMatch && labeled[i].getDescriptor().getContentHash()
+                                           == floodFilled[i].getDescriptor().getContentHash();
+        }
+        CHECK(regionsMatch);
+    }
+}
+
+TEST_CASE("regions within interaction distance") {
+    // two blinkers with one dead column between them interact in the next generation
+    Grid grid(5, 7);
+    for (int r = 1; r <= 3; ++r) {
+        grid.setCellValue(r, 1, 1);
+        grid.setCellValue(r, 3, 1);
+    }
+    CHECK(grid.getNonInteractingRegions().size() == 2);
+    CHECK(grid.getNonInteractingRegionsWithin(1).size() == 2);
+    std::vector<Region> regions = grid.getNonInteractingRegionsWithin(2);
+    REQUIRE(regions.size() == 1);
+    CHECK(regions[0].size() == 6);
+    CHECK(regions[0].getCoordinates()[0] == std::make_pair(1, 1));
+}
+
+template <typename ValueT, typename Layout>
+BasicGrid<ValueT, Layout> convertRegionToGrid(const BasicGrid<ValueT, Layout>& originalGrid, const Region& region) {
     // Calculate the size of the new grid based on the region
     int maxRow = -1, maxCol = -1;
     int minRow = originalGrid.getRows(), minCol = originalGrid.getCols();
     int resultRows=0, resultCols=0;
     bool isEmpty = false;
-    if (region.coordinates.empty()) {
+    if (region.empty()) {
         //return Grid(0,0); // empty grid - no cells
 
         // to help compiler produce code with NRVO, we replace return temporary with return named object
@@ -487,13 +692,22 @@ Grid convertRegionToGrid(const Grid& originalGrid, const Region& region) {
         
     }
 
-    // Determine the bounding box of the region
-    for (const auto& coord : region.coordinates) {
-        if (!originalGrid.isValidCoordinates(coord.first, coord.second)) { continue; }
-        minRow = std::min(minRow, coord.first);
-        minCol = std::min(minCol, coord.second);
-        maxRow = std::max(maxRow, coord.first);
-        maxCol = std::max(maxCol, coord.second);
+    // Bounding box found by labeling can be used as is when all of it is inside the grid
+    if (originalGrid.isValidCoordinates(region.getDescriptor().top, region.getDescriptor().left)
+        && originalGrid.isValidCoordinates(region.getDescriptor().bottom, region.getDescriptor().right)) {
+        minRow = region.getDescriptor().top;
+        minCol = region.getDescriptor().left;
+        maxRow = region.getDescriptor().bottom;
+        maxCol = region.getDescriptor().right;
+    } else {
+        // Determine the bounding box of the cells inside the grid
+        for (const auto& coord : region.getCoordinates()) {
+            if (!originalGrid.isValidCoordinates(coord.first, coord.second)) { continue; }
+            minRow = std::min(minRow, coord.first);
+            minCol = std::min(minCol, coord.second);
+            maxRow = std::max(maxRow, coord.first);
+            maxCol = std::max(maxCol, coord.second);
+        }
     }
 
     if (minRow > originalGrid.getRows()-1 || minCol > originalGrid.getCols()-1) {
@@ -509,17 +723,17 @@ Grid convertRegionToGrid(const Grid& originalGrid, const Region& region) {
 
 grid_create:
     // Create a new grid for the region
-    Grid regionGrid(resultRows, resultCols);
+    BasicGrid<ValueT, Layout> regionGrid(resultRows, resultCols);
 
     if (!isEmpty) {
         // Populate the new grid with cells from the original grid that are in the region
-        for (const auto& coord : region.coordinates) {
+        for (const auto& coord : region.getCoordinates()) {
             int row = coord.first - minRow; // Adjust row index
             int col = coord.second - minCol; // Adjust col index
             if (!regionGrid.isValidCoordinates(row, col)) {continue;}
             
             // Assuming originalGrid has valid cells for the given coordinates
-            regionGrid.cells[row][col] = originalGrid.cells[coord.first][coord.second];
+            regionGrid.cells.setValue(row, col, originalGrid.cells.getValue(coord.first, coord.second));
         }
     }
 
@@ -597,3 +811,254 @@ TEST_CASE("Test convertRegionToGrid function") {
     }
 }
 
+TEST_CASE("Grid is cheap to move") {
+    Grid grid(3, 4);
+    grid.setCellValue(2, 3, 1);
+
+    CHECK(std::is_nothrow_move_constructible_v<Grid>);
+    CHECK(std::is_nothrow_move_assignable_v<Grid>);
+    // grid contains only its cells, no per-grid engines
+    CHECK(sizeof(Grid) == sizeof(CellBuffer<int>));
+
+    Grid moved = std::move(grid);
+    CHECK(moved.getRows() == 3);
+    CHECK(moved.getCellValue(2, 3) == 1);
+    CHECK(grid.getRows() == 0); // moved-from grid is empty, but still valid
+    CHECK(grid.getCols() == 0);
+    CHECK_THROWS_AS(grid.getCell(0, 0), std::out_of_range);
+
+    // copies are independent
+    Grid copy = moved;
+    copy.setCellValue(0, 0, 1);
+    CHECK(moved.getCellValue(0, 0) == 0);
+
+    // grids stored in containers are moved, not copied, when container grows
+    std::vector<Grid> grids;
+    for (int i = 0; i < 10; ++i) {
+        grids.push_back(Grid(i + 1, i + 1));
+    }
+    CHECK(grids[9].getRows() == 10);
+    CHECK(grids[9].update() == false); // engines are available after moves
+}
+
+TEST_CASE("parallel update of grid") {
+    Grid grid(30, 40);
+    grid.fillGridWithRandomValues({0, 1}, {0.5, 0.5});
+    Grid serialGrid = grid;
+    ParallelUpdater parallelUpdater(3);
+
+    for (int generation = 0; generation < 5; ++generation) {
+        CHECK(grid.update(parallelUpdater) == serialGrid.update());
+        CHECK(grid.gridToString() == serialGrid.gridToString());
+    }
+
+    Grid empty(0, 0);
+    CHECK(!empty.update(parallelUpdater));
+}
+
+TEST_CASE("update reports changed cells") {
+    Grid grid(3, 3);
+    grid.setCellValue(0, 1, 1);
+    grid.setCellValue(1, 1, 1);
+    grid.setCellValue(2, 1, 1);
+
+    std::vector<CellChange<int>> changes;
+    CHECK(grid.update(changes));
+    std::vector<CellChange<int>> expected{{0, 1, 0}, {1, 0, 1}, {1, 2, 1}, {2, 1, 0}};
+    CHECK(changes == expected);
+
+    Grid block(4, 4);
+    block.setCellValue(1, 1, 1);
+    block.setCellValue(1, 2, 1);
+    block.setCellValue(2, 1, 1);
+    block.setCellValue(2, 2, 1);
+    CHECK(!block.update(changes));
+    CHECK(changes.empty());
+}
+
+TEST_CASE("history of generations with snapshots") {
+    Grid grid(128, 128); // 16 tiles
+    // blinker inside of a single tile
+    grid.setCellValue(5, 6, 1);
+    grid.setCellValue(6, 6, 1);
+    grid.setCellValue(7, 6, 1);
+
+    std::vector<GridSnapshot<int>> history{grid.snapshot()};
+    for (int generation = 0; generation < 200; ++generation) {
+        grid.update();
+        history.push_back(grid.snapshot(history.back()));
+        CHECK(history.back().sharedTileCount(history[history.size() - 2]) == 15);
+    }
+
+    // period 2: every generation is equal to the one before previous
+    CHECK(history[200] == history[198]);
+    CHECK(history[200] != history[199]);
+    CHECK(history[200] == history[0]);
+
+    // only changed tiles are stored for every generation
+    std::size_t historyBytes = GridSnapshot<int>::memoryBytes(history.begin(), history.end());
+    CHECK(historyBytes * 10 < history.size() * grid.memoryBytes());
+
+    Grid restored(history[1]);
+    CHECK(restored.getCellValue(6, 5) == 1);
+    CHECK(restored.getCellValue(5, 6) == 0);
+    grid.restore(history[1]);
+    CHECK(grid.gridToString() == restored.gridToString());
+}
+
+TEST_CASE("blinker on grids with narrow cell types") {
+    ByteGrid byteGrid(5, 5);
+    BitGrid bitGrid(5, 5);
+    Grid intGrid(5, 5);
+    for (int r = 1; r <= 3; ++r) {
+        byteGrid.setCellValue(r, 2, 1);
+        bitGrid.setCellValue(r, 2, true);
+        intGrid.setCellValue(r, 2, 1);
+    }
+
+    for (int generation = 0; generation < 3; ++generation) {
+        CHECK(byteGrid.update());
+        CHECK(bitGrid.update());
+        CHECK(intGrid.update());
+        // all grids evolve the same way and are printed the same way
+        CHECK(byteGrid.gridToString() == intGrid.gridToString());
+        CHECK(bitGrid.gridToString() == intGrid.gridToString());
+    }
+    CHECK(bitGrid.getCellValue(2, 1));
+    CHECK(bitGrid.getCellValue(2, 3));
+    CHECK(!bitGrid.getCellValue(1, 2));
+}
+
+TEST_CASE("BitGrid cell references and memory usage") {
+    BitGrid bitGrid(64, 64);
+    Grid intGrid(64, 64);
+    ByteGrid byteGrid(64, 64);
+
+    bitGrid.getCell(10, 20).setValue(true); // proxy reference modifies packed bit
+    CHECK(bitGrid.getCellValue(10, 20));
+    CHECK(bitGrid.getCell(10, 20).getValue());
+    CHECK(!bitGrid.getCell(10, 21).getValue());
+    CHECK_THROWS_AS(bitGrid.getCell(64, 0), std::out_of_range);
+
+    CHECK(intGrid.memoryBytes() == 4 * byteGrid.memoryBytes());
+    CHECK(intGrid.memoryBytes() == 32 * bitGrid.memoryBytes());
+}
+
+TEST_CASE("regions of BitGrid") {
+    BitGrid grid(4, 4);
+    grid.setCellValue(0, 0, true);
+    grid.setCellValue(1, 1, true);
+    grid.setCellValue(3, 3, true);
+
+    auto regions = grid.getNonInteractingRegions();
+    CHECK(regions.size() == 2);
+
+    BitGrid regionGrid = convertRegionToGrid(grid, regions[0]);
+    CHECK(regionGrid.getRows() == 2);
+    CHECK(regionGrid.getCols() == 2);
+    CHECK(regionGrid.gridToString() == "1 0 \n0 1 \n");
+}
+
+TEST_CASE("Grid with Morton layout behaves like row-major grid") {
+    Grid grid(37, 21);
+    grid.fillGridWithRandomValues({0, 1}, {0.6, 0.4});
+    BasicGrid<int, MortonLayout> mortonGrid(37, 21);
+    for (int r = 0; r < grid.getRows(); ++r) {
+        for (int c = 0; c < grid.getCols(); ++c) {
+            mortonGrid.setCellValue(r, c, grid.getCellValue(r, c));
+        }
+    }
+
+    for (int generation = 0; generation < 10; ++generation) {
+        CHECK(grid.update() == mortonGrid.update());
+        CHECK(grid.gridToString() == mortonGrid.gridToString());
+    }
+
+    auto regions = grid.getNonInteractingRegions();
+    auto mortonRegions = mortonGrid.getNonInteractingRegions();
+    REQUIRE(regions.size() == mortonRegions.size());
+    for (size_t i = 0; i < regions.size(); ++i) {
+        CHECK(regions[i].getCoordinates() == mortonRegions[i].getCoordinates());
+        CHECK(convertRegionToGrid(grid, regions[i]).gridToString()
+              == convertRegionToGrid(mortonGrid, mortonRegions[i]).gridToString());
+    }
+
+    auto snapshot = mortonGrid.snapshot();
+    BasicGrid<int, MortonLayout> restored(snapshot);
+    CHECK(restored.gridToString() == grid.gridToString());
+}
+
+TEST_CASE("cells with values other than 0 and 1 are updated the same for every layout") {
+    CellBuffer<int> cells(70, 70);
+    CellBuffer<int, MortonLayout> mortonCells(70, 70);
+    std::mt19937 random(9);
+    std::discrete_distribution<int> value({5, 3, 2}); // 0, 1 or 2
+    for (int r = 0; r < 70; ++r) {
+        for (int c = 0; c < 70; ++c) {
+            int cellValue = value(random);
+            cells.setValue(r, c, cellValue);
+            mortonCells.setValue(r, c, cellValue);
+        }
+    }
+    // 2 with no live neighbors keeps its value and is not a change
+    for (int r = 0; r < 3; ++r) {
+        for (int c = 0; c < 3; ++c) {
+            cells.setValue(r, c, 0);
+            mortonCells.setValue(r, c, 0);
+        }
+    }
+    cells.setValue(0, 0, 2);
+    mortonCells.setValue(0, 0, 2);
+
+    Updater updater;
+    std::vector<CellChange<int>> changes;
+    std::vector<CellChange<int>> mortonChanges;
+    CellBuffer<int> next = updater.update(cells, &changes);
+    CellBuffer<int, MortonLayout> mortonNext = updater.update(mortonCells, &mortonChanges);
+    CHECK(changes == mortonChanges);
+    CHECK(next.getValue(0, 0) == 2);
+    bool cellsMatch = true;
+    for (int r = 0; r < 70; ++r) {
+        for (int c = 0; c < 70; ++c) {
+            cellsMatch = cellsMatch && next.getValue(r, c) == mortonNext.getValue(r, c);
+        }
+    }
+    CHECK(cellsMatch);
+}
+
+TEST_CASE("tiled update of Morton grid matches row-major update") {
+    // larger than one 64 x 64 tile in both directions, and not a multiple of it
+    CellBuffer<int> cells(150, 70);
+    CellBuffer<int, MortonLayout> mortonCells(150, 70);
+    std::mt19937 random(5);
+    std::bernoulli_distribution alive(0.4);
+    for (int r = 0; r < 150; ++r) {
+        for (int c = 0; c < 70; ++c) {
+            int value = alive(random);
+            cells.setValue(r, c, value);
+            mortonCells.setValue(r, c, value);
+        }
+    }
+    for (BoundaryMode mode : {BoundaryMode::Dead, BoundaryMode::Toroidal, BoundaryMode::Reflective}) {
+        Updater updater(mode);
+        std::vector<CellChange<int>> changes;
+        std::vector<CellChange<int>> mortonChanges;
+        CellBuffer<int> next = updater.update(cells, &changes);
+        CellBuffer<int, MortonLayout> mortonNext = updater.update(mortonCells, &mortonChanges);
+        CHECK(changes == mortonChanges);
+
+        // bands that start and end inside tiles, as parallel updates use them
+        CellBuffer<int, MortonLayout> banded(150, 70);
+        updater.updateRows(mortonCells, banded, 0, 50);
+        updater.updateRows(mortonCells, banded, 50, 130);
+        updater.updateRows(mortonCells, banded, 130, 150);
+        bool cellsMatch = true;
+        for (int r = 0; r < 150; ++r) {
+            for (int c = 0; c < 70; ++c) {
+                cellsMatch = cellsMatch && next.getValue(r, c) == mortonNext.getValue(r, c)
+                             && next.getValue(r, c) == banded.getValue(r, c);
+            }
+        }
+        CHECK(cellsMatch);
+    }
+}
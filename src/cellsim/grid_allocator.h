@@ -0,0 +1,396 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <new>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#if defined(__linux__)
+#include <sys/mman.h>
+#endif
+
+#include "../doctest.h"
+
+// How memory for a grid buffer was obtained
+enum class GridAllocationMode {
+    Aligned,              // small buffer: operator new aligned to cache line
+    HugeTlb,                       // mmap with MAP_HUGETLB: explicitly reserved huge pages (only if enabled)
+    TransparentHugePagesRequested, // 2M-aligned mmap + madvise(MADV_HUGEPAGE) accepted: kernel may back buffer
+                                   // with huge pages, but it is a hint, pages are not checked
+    RegularPages                   // mmap without huge pages (they are disabled or not supported)
+};
+
+// Number of allocations made in every mode, to check which one was actually used
+struct GridAllocationStats {
+    std::size_t aligned = 0;
+    std::size_t hugeTlb = 0;
+    std::size_t transparentHugePagesRequested = 0;
+    std::size_t regularPages = 0;
+    std::size_t hugeTlbFailures = 0; // MAP_HUGETLB was enabled, but no huge pages were available
+};
+
+class GridAllocationCounters {
+public:
+    static void count(GridAllocationMode mode) {
+        switch (mode) {
+            case GridAllocationMode::Aligned: aligned++; break;
+            case GridAllocationMode::HugeTlb: hugeTlb++; break;
+            case GridAllocationMode::TransparentHugePagesRequested: transparentHugePagesRequested++; break;
+            case GridAllocationMode::RegularPages: regularPages++; break;
+        }
+    }
+
+    static void countHugeTlbFailure() {
+        hugeTlbFailures++;
+    }
+
+    static GridAllocationStats get() {
+        GridAllocationStats stats;
+        stats.aligned = aligned;
+        stats.hugeTlb = hugeTlb;
+        stats.transparentHugePagesRequested = transparentHugePagesRequested;
+        stats.regularPages = regularPages;
+        stats.hugeTlbFailures = hugeTlbFailures;
+        return stats;
+    }
+
+private:
+    static inline std::atomic<std::size_t> aligned{0};
+    static inline std::atomic<std::size_t> hugeTlb{0};
+    static inline std::atomic<std::size_t> transparentHugePagesRequested{0};
+    static inline std::atomic<std::size_t> regularPages{0};
+    static inline std::atomic<std::size_t> hugeTlbFailures{0};
+};
+
+// Options shared by all grid allocators
+class GridAllocationSettings {
+public:
+    // try reserved huge pages (vm.nr_hugepages) before transparent ones
+    static void setHugeTlbEnabled(bool enabled) {
+        hugeTlb = enabled;
+    }
+
+    static bool isHugeTlbEnabled() {
+        return hugeTlb;
+    }
+
+private:
+    static inline std::atomic<bool> hugeTlb{false};
+};
+
+// Allocator for cell buffers.
+// Every buffer is aligned to the cache line, which is also enough for the widest SIMD registers (AVX-512).
+// Large buffers are mapped directly from the OS, aligned to 2M, and transparent huge pages are requested
+// for them: a grid of 8k x 8k cells takes hundreds of megabytes, which is millions of 4K pages,
+// and TLB misses in update() become noticeable. With 2M pages there are 512 times fewer of them.
+// Reserved huge pages (MAP_HUGETLB) are tried only after GridAllocationSettings::setHugeTlbEnabled(true), because on most machines
+// none are reserved and every attempt would be a failing system call; after the first failure they are
+// not tried again.
+// Mode is chosen by size only, so deallocate() knows how to release memory without extra bookkeeping.
+template <typename T>
+class GridAllocator {
+public:
+    using value_type = T;
+
+    static constexpr std::size_t alignment = 64;
+    static constexpr std::size_t hugePageSize = std::size_t{2} << 20;
+
+    GridAllocator() = default;
+
+    template <typename U>
+    GridAllocator(const GridAllocator<U>&) {}
+
+    T* allocate(std::size_t n) {
+        std::size_t bytes = n * sizeof(T);
+#if defined(__linux__)
+        if (bytes >= hugePageSize) {
+            return static_cast<T*>(allocatePages(roundUpToHugePage(bytes)));
+        }
+#endif
+        GridAllocationCounters::count(GridAllocationMode::Aligned);
+        return static_cast<T*>(::operator new(bytes, std::align_val_t(alignment)));
+    }
+
+    void deallocate(T* pointer, std::size_t n) {
+        std::size_t bytes = n * sizeof(T);
+#if defined(__linux__)
+        if (bytes >= hugePageSize) {
+            munmap(pointer, roundUpToHugePage(bytes));
+            return;
+        }
+#endif
+        ::operator delete(pointer, std::align_val_t(alignment));
+    }
+
+    // true if memory of n elements comes directly from the OS, and so it is already filled with zeros
+    static bool isZeroFilled(std::size_t n) {
+#if defined(__linux__)
+        return n * sizeof(T) >= hugePageSize;
+#else
+        (void)n;
+        return false;
+#endif
+    }
+
+    // allocators are stateless, so memory allocated by one of them can be released by any other
+    template <typename U>
+    bool operator==(const GridAllocator<U>&) const { return true; }
+
+    template <typename U>
+    bool operator!=(const GridAllocator<U>&) const { return false; }
+
+private:
+    static std::size_t roundUpToHugePage(std::size_t bytes) {
+        return (bytes + hugePageSize - 1) / hugePageSize * hugePageSize;
+    }
+
+#if defined(__linux__)
+    // false if transparent huge pages are switched off in the whole system ("never")
+    static bool transparentHugePagesAvailable() {
+        static const bool available = [] {
+            std::ifstream settings("/sys/kernel/mm/transparent_hugepage/enabled");
+            std::string line;
+            return std::getline(settings, line) && line.find("[never]") == std::string::npos;
+        }();
+        return available;
+    }
+
+    // bytes is a multiple of hugePageSize; memory is aligned to hugePageSize
+    static void* allocatePages(std::size_t bytes) {
+#if defined(MAP_HUGETLB)
+        if (GridAllocationSettings::isHugeTlbEnabled()) {
+            void* hugePages = mmap(nullptr, bytes, PROT_READ | PROT_WRITE,
+                                   MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+            if (hugePages != MAP_FAILED) {
+                GridAllocationCounters::count(GridAllocationMode::HugeTlb);
+                return hugePages;
+            }
+            GridAllocationCounters::countHugeTlbFailure();
+            GridAllocationSettings::setHugeTlbEnabled(false); // no reserved pages, don't try every time
+        }
+#endif
+        // map one huge page more and cut unaligned head and tail, so that the whole buffer can be
+        // backed by huge pages and munmap(pointer, bytes) releases all of it
+        void* mapped = mmap(nullptr, bytes + hugePageSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (mapped == MAP_FAILED) {
+            throw std::bad_alloc();
+        }
+        std::uintptr_t begin = reinterpret_cast<std::uintptr_t>(mapped);
+        std::uintptr_t aligned = (begin + hugePageSize - 1) / hugePageSize * hugePageSize;
+        if (aligned > begin) {
+            munmap(mapped, aligned - begin);
+        }
+        std::size_t tail = begin + bytes + hugePageSize - (aligned + bytes);
+        if (tail > 0) {
+            munmap(reinterpret_cast<void*>(aligned + bytes), tail);
+        }
+        void* pointer = reinterpret_cast<void*>(aligned);
+#if defined(MADV_HUGEPAGE)
+        if (transparentHugePagesAvailable() && madvise(pointer, bytes, MADV_HUGEPAGE) == 0) {
+            GridAllocationCounters::count(GridAllocationMode::TransparentHugePagesRequested);
+            return pointer;
+        }
+#endif
+        GridAllocationCounters::count(GridAllocationMode::RegularPages);
+        return pointer;
+    }
+#endif
+};
+
+// Fixed-size array of value-initialized elements in memory from GridAllocator.
+// Unlike std::vector, it does not write zeros into memory that OS already gave zero-filled:
+// pages of a large array are not touched until the first real write. So in a multithreaded
+// update every page gets placed on NUMA node of the thread that writes it first (first-touch policy).
+template <typename T>
+class GridArray {
+public:
+    explicit GridArray(std::size_t size = 0) : elements(nullptr), count(size), owning(true) {
+        if (count == 0) {
+            return;
+        }
+        elements = allocator().allocate(count);
+        if (!canSkipInitialization(count)) {
+            std::uninitialized_value_construct_n(elements, count);
+        }
+    }
+
+    // array over memory owned by someone else (for example, memory-mapped file):
+    // elements are used as they are and memory is not released by the array
+    static GridArray view(T* external, std::size_t size) {
+        GridArray array;
+        array.elements = external;
+        array.count = size;
+        array.owning = false;
+        return array;
+    }
+
+    // copy always owns its memory, even if other is a view
+    GridArray(const GridArray& other) : elements(nullptr), count(other.count), owning(true) {
+        if (count != 0) {
+            elements = allocator().allocate(count);
+            std::uninitialized_copy_n(other.elements, count, elements);
+        }
+    }
+
+    GridArray(GridArray&& other) noexcept
+        : elements(std::exchange(other.elements, nullptr)), count(std::exchange(other.count, 0)),
+          owning(std::exchange(other.owning, true)) {}
+
+    GridArray& operator=(const GridArray& other) {
+        if (this != &other) {
+            GridArray copy(other);
+            swap(copy);
+        }
+        return *this;
+    }
+
+    GridArray& operator=(GridArray&& other) noexcept {
+        GridArray moved(std::move(other));
+        swap(moved);
+        return *this;
+    }
+
+    ~GridArray() {
+        if (elements != nullptr && owning) {
+            std::destroy_n(elements, count);
+            allocator().deallocate(elements, count);
+        }
+    }
+
+    void swap(GridArray& other) noexcept {
+        std::swap(elements, other.elements);
+        std::swap(count, other.count);
+        std::swap(owning, other.owning);
+    }
+
+    std::size_t size() const { return count; }
+
+    T* data() { return elements; }
+
+    const T* data() const { return elements; }
+
+    T& operator[](std::size_t index) { return elements[index]; }
+
+    const T& operator[](std::size_t index) const { return elements[index]; }
+
+    bool operator==(const GridArray& other) const {
+        return count == other.count && std::equal(elements, elements + count, other.elements);
+    }
+
+    bool operator!=(const GridArray& other) const {
+        return !(*this == other);
+    }
+
+private:
+    static GridAllocator<T> allocator() {
+        return GridAllocator<T>();
+    }
+
+    // value-initialized numbers and cells that hold a number are all zero bits
+    static bool canSkipInitialization(std::size_t count) {
+        return std::is_trivially_copyable_v<T> && std::is_trivially_destructible_v<T>
+               && GridAllocator<T>::isZeroFilled(count);
+    }
+
+    T* elements;
+    std::size_t count;
+    bool owning;
+};
+
+TEST_CASE("GridAllocator aligns small buffers to cache line") {
+    GridAllocationStats before = GridAllocationCounters::get();
+    std::vector<int, GridAllocator<int>> buffer(100, 1);
+    GridAllocationStats after = GridAllocationCounters::get();
+
+    CHECK(reinterpret_cast<std::uintptr_t>(buffer.data()) % GridAllocator<int>::alignment == 0);
+    CHECK(after.aligned == before.aligned + 1);
+    CHECK(buffer[99] == 1);
+}
+
+TEST_CASE("GridAllocator maps large buffers from the OS") {
+    GridAllocationStats before = GridAllocationCounters::get();
+    std::vector<int, GridAllocator<int>> buffer(1024 * 1024, 1); // 4 MB
+    GridAllocationStats after = GridAllocationCounters::get();
+
+    CHECK(reinterpret_cast<std::uintptr_t>(buffer.data()) % GridAllocator<int>::alignment == 0);
+    std::size_t largeAllocations = (after.hugeTlb - before.hugeTlb)
+                                 + (after.transparentHugePagesRequested - before.transparentHugePagesRequested)
+                                 + (after.regularPages - before.regularPages);
+#if defined(__linux__)
+    // exactly one mode is used: huge pages when system allows it, otherwise regular pages
+    CHECK(largeAllocations == 1);
+    // aligned to huge page, so the first and the last 2M of the buffer can be huge pages too
+    CHECK(reinterpret_cast<std::uintptr_t>(buffer.data()) % GridAllocator<int>::hugePageSize == 0);
+    // reserved huge pages are not tried unless enabled
+    CHECK(after.hugeTlbFailures == before.hugeTlbFailures);
+    CHECK(after.hugeTlb == before.hugeTlb);
+#else
+    CHECK(largeAllocations == 0);
+    CHECK(after.aligned == before.aligned + 1);
+#endif
+    CHECK(buffer[1024 * 1024 - 1] == 1);
+}
+
+#if defined(__linux__) && defined(MAP_HUGETLB)
+TEST_CASE("reserved huge pages are tried only when enabled") {
+    GridAllocationSettings::setHugeTlbEnabled(true);
+    GridAllocationStats before = GridAllocationCounters::get();
+    {
+        std::vector<int, GridAllocator<int>> first(1024 * 1024, 1);
+        std::vector<int, GridAllocator<int>> second(1024 * 1024, 1);
+        CHECK(second[1024 * 1024 - 1] == 1);
+    }
+    GridAllocationStats after = GridAllocationCounters::get();
+    if (after.hugeTlbFailures != before.hugeTlbFailures) {
+        // no reserved pages: tried once, then switched off
+        CHECK(after.hugeTlbFailures == before.hugeTlbFailures + 1);
+        CHECK(!GridAllocationSettings::isHugeTlbEnabled());
+    } else {
+        CHECK(after.hugeTlb == before.hugeTlb + 2);
+    }
+    GridAllocationSettings::setHugeTlbEnabled(false);
+}
+#endif
+
+TEST_CASE("GridArray elements are value-initialized") {
+    GridArray<int> small(10);
+    GridArray<int> large(1024 * 1024); // zero pages from OS, not written during construction
+    CHECK(small[9] == 0);
+    CHECK(large[0] == 0);
+    CHECK(large[1024 * 1024 - 1] == 0);
+
+    large[5] = 7;
+    GridArray<int> copy = large;
+    CHECK(copy[5] == 7);
+    CHECK(copy == large);
+
+    GridArray<int> moved = std::move(copy);
+    CHECK(moved[5] == 7);
+    CHECK(copy.size() == 0);
+    CHECK(copy.data() == nullptr);
+
+    small = moved;
+    CHECK(small.size() == 1024 * 1024);
+    CHECK(small[5] == 7);
+}
+
+TEST_CASE("GridArray view does not own memory") {
+    std::vector<int> memory{1, 2, 3};
+    {
+        GridArray<int> view = GridArray<int>::view(memory.data(), memory.size());
+        CHECK(view.data() == memory.data());
+        view[1] = 5;
+
+        GridArray<int> copy = view; // copy owns new memory
+        CHECK(copy.data() != memory.data());
+        copy[0] = 7;
+    }
+    CHECK(memory == std::vector<int>{1, 5, 3});
+}
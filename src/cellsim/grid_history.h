@@ -0,0 +1,185 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include "../doctest.h"
+
+#include "grid.h"
+#include "grid_snapshot.h"
+
+struct HistoryStats {
+    int generations = 0;          // number of recorded generations, including the initial one
+    std::size_t keyframes = 0;
+    std::size_t deltaCells = 0;   // total number of cell changes stored between keyframes
+    std::size_t memoryBytes = 0;  // keyframes (shared tiles counted once) and deltas
+    std::chrono::nanoseconds lastSeekTime{0};
+    std::chrono::nanoseconds totalSeekTime{0};
+    std::size_t seeks = 0;
+};
+
+// History of a simulation that allows to get grid of any earlier generation.
+// Every keyframeInterval generations the whole grid is stored as a snapshot (keyframe),
+// for other generations only cells changed by update are stored (delta).
+// Grid of generation k is rebuilt from the nearest keyframe before it by applying
+// at most keyframeInterval - 1 deltas. Larger interval needs less memory, but seek is slower.
+template <typename ValueT, typename Layout = RowMajorLayout>
+class GenerationHistory {
+public:
+    // initial state of grid becomes generation 0
+    explicit GenerationHistory(const BasicGrid<ValueT, Layout>& initial, int keyframeInterval = 64)
+        : keyframeInterval(keyframeInterval) {
+        if (keyframeInterval < 1) {
+            throw std::invalid_argument("Keyframe interval must be positive.");
+        }
+        keyframes.emplace_back(0, initial.snapshot());
+        deltas.emplace_back(); // generation 0 is a keyframe
+    }
+
+    // Updates grid by one generation and records it. Returns result of grid.update()
+    bool step(BasicGrid<ValueT, Layout>& grid) {
+        std::vector<CellChange<ValueT>> changes;
+        bool hasChanged = grid.update(changes);
+        record(grid, std::move(changes));
+        return hasChanged;
+    }
+
+    // Records next generation: grid is its state, changes - cells changed by update from previous generation
+    void record(const BasicGrid<ValueT, Layout>& grid, std::vector<CellChange<ValueT>> changes) {
+        int generation = getGenerationCount();
+        if (generation - keyframes.back().first >= keyframeInterval) {
+            // keyframe shares unchanged tiles with the previous one
+            keyframes.emplace_back(generation, grid.snapshot(keyframes.back().second));
+            deltas.emplace_back();
+        } else {
+            deltas.push_back(std::move(changes));
+        }
+    }
+
+    // number of recorded generations, including generation 0
+    int getGenerationCount() const {
+        return static_cast<int>(deltas.size());
+    }
+
+    int getKeyframeInterval() const {
+        return keyframeInterval;
+    }
+
+    // affects only generations recorded after the call
+    void setKeyframeInterval(int newInterval) {
+        if (newInterval < 1) {
+            throw std::invalid_argument("Keyframe interval must be positive.");
+        }
+        keyframeInterval = newInterval;
+    }
+
+    // Rebuilds grid of the given generation
+    BasicGrid<ValueT, Layout> seek(int generation) {
+        if (generation < 0 || generation >= getGenerationCount()) {
+            throw std::out_of_range("Generation is not recorded");
+        }
+        auto start = std::chrono::steady_clock::now();
+
+        // keyframes are sorted by generation: binary search for the last keyframe not after generation
+        auto keyframe = std::upper_bound(keyframes.begin(), keyframes.end(), generation,
+            [](int value, const std::pair<int, GridSnapshot<ValueT>>& entry) {
+                return value < entry.first;
+            }) - 1;
+
+        BasicGrid<ValueT, Layout> grid(keyframe->second);
+        for (int g = keyframe->first + 1; g <= generation; ++g) {
+            for (const auto& change : deltas[g]) {
+                grid.setCellValue(change.row, change.col, change.value);
+            }
+        }
+
+        stats.lastSeekTime = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - start);
+        stats.totalSeekTime += stats.lastSeekTime;
+        stats.seeks++;
+        return grid;
+    }
+
+    HistoryStats getStats() const {
+        HistoryStats result = stats;
+        result.generations = getGenerationCount();
+        result.keyframes = keyframes.size();
+
+        std::vector<GridSnapshot<ValueT>> keyframeSnapshots;
+        for (const auto& keyframe : keyframes) {
+            keyframeSnapshots.push_back(keyframe.second);
+        }
+        result.memoryBytes = GridSnapshot<ValueT>::memoryBytes(keyframeSnapshots.begin(), keyframeSnapshots.end());
+        result.deltaCells = 0;
+        for (const auto& delta : deltas) {
+            result.deltaCells += delta.size();
+            result.memoryBytes += sizeof(delta) + delta.capacity() * sizeof(CellChange<ValueT>);
+        }
+        return result;
+    }
+
+private:
+    int keyframeInterval;
+    std::vector<std::pair<int, GridSnapshot<ValueT>>> keyframes; // (generation, snapshot), sorted by generation
+    std::vector<std::vector<CellChange<ValueT>>> deltas; // deltas[g] turns generation g-1 into g, empty for keyframes
+    HistoryStats stats;
+};
+
+TEST_CASE("history rebuilds every recorded generation") {
+    Grid grid(40, 40);
+    grid.fillGridWithRandomValues({0, 1}, {0.5, 0.5});
+
+    GenerationHistory<int> history(grid, 8);
+    std::vector<std::string> expected{grid.gridToString()};
+    for (int generation = 1; generation <= 50; ++generation) {
+        history.step(grid);
+        expected.push_back(grid.gridToString());
+    }
+
+    CHECK(history.getGenerationCount() == 51);
+    CHECK(history.getStats().keyframes == 7); // generations 0, 8, ..., 48
+
+    for (int generation : {0, 1, 7, 8, 9, 31, 48, 50}) {
+        CHECK(history.seek(generation).gridToString() == expected[generation]);
+    }
+    CHECK(history.getStats().seeks == 8);
+    CHECK_THROWS_AS(history.seek(51), std::out_of_range);
+    CHECK_THROWS_AS(history.seek(-1), std::out_of_range);
+}
+
+TEST_CASE("keyframe interval trades memory for seek work") {
+    Grid grid(64, 64);
+    grid.fillGridWithRandomValues({0, 1}, {0.7, 0.3});
+    Grid sameGrid = grid;
+
+    GenerationHistory<int> everyGeneration(grid, 1);
+    GenerationHistory<int> sparse(sameGrid, 16);
+    for (int generation = 0; generation < 32; ++generation) {
+        everyGeneration.step(grid);
+        sparse.step(sameGrid);
+    }
+
+    HistoryStats denseStats = everyGeneration.getStats();
+    HistoryStats sparseStats = sparse.getStats();
+    CHECK(denseStats.keyframes == 33);
+    CHECK(denseStats.deltaCells == 0);
+    CHECK(sparseStats.keyframes == 3);
+    CHECK(sparseStats.memoryBytes < denseStats.memoryBytes);
+    // full copies of every generation would take even more
+    CHECK(sparseStats.memoryBytes < 33 * grid.memoryBytes());
+
+    CHECK(everyGeneration.seek(20).gridToString() == sparse.seek(20).gridToString());
+
+    // changing interval affects new generations only
+    sparse.setKeyframeInterval(4);
+    for (int generation = 0; generation < 8; ++generation) {
+        sparse.step(sameGrid);
+    }
+    CHECK(sparse.getStats().keyframes == 5); // 0, 16, 32, 36, 40
+    CHECK(sparse.seek(40).gridToString() == sameGrid.gridToString());
+    CHECK_THROWS_AS(sparse.setKeyframeInterval(0), std::invalid_argument);
+}
@@ -0,0 +1,245 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <stdexcept>
+#include <type_traits>
+#include <unordered_set>
+#include <vector>
+
+#include "../doctest.h"
+
+#include "cell_buffer.h"
+
+// Immutable copy of grid cells taken at some moment (for example, one generation of simulation).
+// Cells are split into square tiles, every tile is a reference-counted block.
+// When snapshot is taken with previous snapshot as a base, tiles that did not change
+// are shared with it instead of being copied, so history of many generations
+// costs memory only for the tiles that changed.
+template <typename ValueT>
+class GridSnapshot {
+public:
+    static constexpr int tileSize = 32; // tile has tileSize x tileSize cells (tiles at the edges may be smaller)
+
+    // cell values of one tile in row-major order
+    using Tile = std::vector<ValueT>;
+
+    GridSnapshot() : rows(0), cols(0), tileRows(0), tileCols(0) {}
+
+    // takes snapshot of cells; tiles that are equal to tiles of previous snapshot are shared with it
+    template <typename Layout>
+    static GridSnapshot capture(const CellBuffer<ValueT, Layout>& cells, const GridSnapshot& previous = GridSnapshot()) {
+        GridSnapshot snapshot(cells.getRows(), cells.getCols());
+        bool canShare = previous.rows == snapshot.rows && previous.cols == snapshot.cols;
+
+        for (int tileRow = 0; tileRow < snapshot.tileRows; ++tileRow) {
+            for (int tileCol = 0; tileCol < snapshot.tileCols; ++tileCol) {
+                std::size_t tileIndex = snapshot.tileIndex(tileRow, tileCol);
+                if (canShare && snapshot.tileEquals(*previous.tiles[tileIndex], cells, tileRow, tileCol)) {
+                    snapshot.tiles[tileIndex] = previous.tiles[tileIndex];
+                } else {
+                    snapshot.tiles[tileIndex] = snapshot.copyTile(cells, tileRow, tileCol);
+                }
+            }
+        }
+        return snapshot;
+    }
+
+    int getRows() const { return rows; }
+
+    int getCols() const { return cols; }
+
+    ValueT getCellValue(int row, int col) const {
+        if (row < 0 || row >= rows || col < 0 || col >= cols) {
+            throw std::out_of_range("Cell index out of range");
+        }
+        const Tile& tile = *tiles[tileIndex(row / tileSize, col / tileSize)];
+        return tile[(row % tileSize) * tileWidth(col / tileSize) + col % tileSize];
+    }
+
+    // copies cells of snapshot into new buffer, for example to restore grid
+    template <typename Layout = RowMajorLayout>
+    CellBuffer<ValueT, Layout> toCells() const {
+        CellBuffer<ValueT, Layout> cells(rows, cols);
+        for (int r = 0; r < rows; ++r) {
+            for (int c = 0; c < cols; ++c) {
+                cells.setValue(r, c, getCellValue(r, c));
+            }
+        }
+        return cells;
+    }
+
+    std::size_t tileCount() const {
+        return tiles.size();
+    }
+
+    // number of tiles that are the same memory blocks in both snapshots
+    std::size_t sharedTileCount(const GridSnapshot& other) const {
+        if (rows != other.rows || cols != other.cols) {
+            return 0;
+        }
+        std::size_t count = 0;
+        for (std::size_t i = 0; i < tiles.size(); ++i) {
+            if (tiles[i] == other.tiles[i]) {
+                ++count;
+            }
+        }
+        return count;
+    }
+
+    // memory used by this snapshot as if it did not share anything
+    std::size_t memoryBytes() const {
+        std::size_t bytes = tiles.size() * sizeof(std::shared_ptr<const Tile>);
+        for (const auto& tile : tiles) {
+            bytes += tileBytes(*tile);
+        }
+        return bytes;
+    }
+
+    // memory used by a set of snapshots, every shared tile is counted once
+    template <typename Iterator>
+    static std::size_t memoryBytes(Iterator begin, Iterator end) {
+        std::unordered_set<const Tile*> counted;
+        std::size_t bytes = 0;
+        for (auto it = begin; it != end; ++it) {
+            bytes += it->tiles.size() * sizeof(std::shared_ptr<const Tile>);
+            for (const auto& tile : it->tiles) {
+                if (counted.insert(tile.get()).second) {
+                    bytes += tileBytes(*tile);
+                }
+            }
+        }
+        return bytes;
+    }
+
+    bool operator==(const GridSnapshot& other) const {
+        if (rows != other.rows || cols != other.cols) {
+            return false;
+        }
+        for (std::size_t i = 0; i < tiles.size(); ++i) {
+            // shared tiles are equal without comparing their contents
+            if (tiles[i] != other.tiles[i] && *tiles[i] != *other.tiles[i]) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool operator!=(const GridSnapshot& other) const {
+        return !(*this == other);
+    }
+
+private:
+    GridSnapshot(int rows, int cols)
+        : rows(rows), cols(cols),
+          tileRows((rows + tileSize - 1) / tileSize), tileCols((cols + tileSize - 1) / tileSize),
+          tiles(static_cast<std::size_t>(tileRows) * tileCols) {}
+
+    std::size_t tileIndex(int tileRow, int tileCol) const {
+        return static_cast<std::size_t>(tileRow) * tileCols + tileCol;
+    }
+
+    int tileHeight(int tileRow) const {
+        return std::min(tileSize, rows - tileRow * tileSize);
+    }
+
+    int tileWidth(int tileCol) const {
+        return std::min(tileSize, cols - tileCol * tileSize);
+    }
+
+    static std::size_t tileBytes(const Tile& tile) {
+        if constexpr (std::is_same_v<ValueT, bool>) {
+            return (tile.size() + 7) / 8; // std::vector<bool> stores bits
+        } else {
+            return tile.size() * sizeof(ValueT);
+        }
+    }
+
+    template <typename Layout>
+    bool tileEquals(const Tile& tile, const CellBuffer<ValueT, Layout>& cells, int tileRow, int tileCol) const {
+        int height = tileHeight(tileRow);
+        int width = tileWidth(tileCol);
+        for (int r = 0; r < height; ++r) {
+            for (int c = 0; c < width; ++c) {
+                if (tile[r * width + c] != cells.getValue(tileRow * tileSize + r, tileCol * tileSize + c)) {
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+
+    template <typename Layout>
+    std::shared_ptr<const Tile> copyTile(const CellBuffer<ValueT, Layout>& cells, int tileRow, int tileCol) const {
+        int height = tileHeight(tileRow);
+        int width = tileWidth(tileCol);
+        auto tile = std::make_shared<Tile>(static_cast<std::size_t>(height) * width);
+        for (int r = 0; r < height; ++r) {
+            for (int c = 0; c < width; ++c) {
+                (*tile)[r * width + c] = cells.getValue(tileRow * tileSize + r, tileCol * tileSize + c);
+            }
+        }
+        return tile;
+    }
+
+    int rows;
+    int cols;
+    int tileRows;
+    int tileCols;
+    std::vector<std::shared_ptr<const Tile>> tiles;
+};
+
+TEST_CASE("snapshot keeps cell values") {
+    CellBuffer<int> cells(40, 70); // several tiles, edge tiles are partial
+    cells.setValue(0, 0, 1);
+    cells.setValue(39, 69, 2);
+    cells.setValue(33, 5, 3);
+
+    auto snapshot = GridSnapshot<int>::capture(cells);
+    CHECK(snapshot.getRows() == 40);
+    CHECK(snapshot.getCols() == 70);
+    CHECK(snapshot.tileCount() == 6);
+    CHECK(snapshot.getCellValue(0, 0) == 1);
+    CHECK(snapshot.getCellValue(39, 69) == 2);
+    CHECK(snapshot.getCellValue(33, 5) == 3);
+    CHECK(snapshot.getCellValue(33, 6) == 0);
+    CHECK_THROWS_AS(snapshot.getCellValue(40, 0), std::out_of_range);
+
+    cells.setValue(0, 0, 5); // snapshot is not affected by later changes
+    CHECK(snapshot.getCellValue(0, 0) == 1);
+    cells.setValue(0, 0, 1);
+    CHECK(snapshot.toCells() == cells);
+}
+
+TEST_CASE("snapshot shares unchanged tiles with previous snapshot") {
+    CellBuffer<int> cells(64, 64); // 4 tiles
+    auto first = GridSnapshot<int>::capture(cells);
+
+    cells.setValue(40, 40, 1); // change only the last tile
+    auto second = GridSnapshot<int>::capture(cells, first);
+
+    CHECK(second.sharedTileCount(first) == 3);
+    CHECK(second != first);
+    CHECK(first.getCellValue(40, 40) == 0);
+    CHECK(second.getCellValue(40, 40) == 1);
+
+    std::vector<GridSnapshot<int>> both{first, second};
+    std::size_t tileBytes = 32 * 32 * sizeof(int);
+    CHECK(GridSnapshot<int>::memoryBytes(both.begin(), both.end()) < first.memoryBytes() + 2 * tileBytes);
+
+    // equal contents, but different tiles
+    cells.setValue(40, 40, 0);
+    auto third = GridSnapshot<int>::capture(cells);
+    CHECK(third.sharedTileCount(first) == 0);
+    CHECK(third == first);
+}
+
+TEST_CASE("snapshot of bit-packed cells") {
+    CellBuffer<bool> cells(10, 100);
+    cells.setValue(9, 99, true);
+    auto snapshot = GridSnapshot<bool>::capture(cells);
+    CHECK(snapshot.getCellValue(9, 99));
+    CHECK(!snapshot.getCellValue(9, 98));
+    CHECK(snapshot.toCells() == cells);
+}
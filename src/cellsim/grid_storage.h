@@ -7,27 +7,45 @@
 #include "../doctest.h"
 
 #include "grid.h"
+#include "region_view.h"
 
 
 class GridStorage {
 private:
     std::unordered_map<std::string, int> gridMap;
+    std::string keyBuffer; // reused by addGrid(RegionView), so known regions are counted without allocation
 
 public:
 
     size_t size() const {
         return gridMap.size();
     }
-    int& operator[](const Grid& grid) {
+    template <typename ValueT, typename Layout>
+    int& operator[](const BasicGrid<ValueT, Layout>& grid) {
         return gridMap[grid.gridToString()];
     }
 
     // Adds a new grid or increments the count of an existing grid
-    void addGrid(const Grid& grid) {
+    // grids with different cell types but the same values are considered equal
+    template <typename ValueT, typename Layout>
+    void addGrid(const BasicGrid<ValueT, Layout>& grid) {
         std::string gridString = grid.gridToString();
         gridMap[gridString]++;
     }
 
+    // Adds the grid of a region without making it, the same as addGrid(convertRegionToGrid(grid, region))
+    template <typename ValueT, typename Layout>
+    void addGrid(const RegionView<ValueT, Layout>& view) {
+        keyBuffer.clear();
+        view.appendTo(keyBuffer);
+        auto found = gridMap.find(keyBuffer);
+        if (found != gridMap.end()) {
+            found->second++;
+        } else {
+            gridMap.emplace(keyBuffer, 1);
+        }
+    }
+
     //Overload the << operator for writing to a stream
     friend std::ostream& operator<<(std::ostream& out, const GridStorage& storage) {
         for (const auto& entry : storage.gridMap) {
@@ -233,4 +251,34 @@ TEST_CASE("GridStorage operations using streams") {
     CHECK(newStorage[grid1] == 3);
     CHECK(newStorage[grid2] == 1);
 
-}
\ No newline at end of file
+}
+
+TEST_CASE("GridStorage with different cell types") {
+    GridStorage storage;
+    Grid intGrid(2, 2);
+    intGrid.setCellValue(0, 1, 1);
+    BitGrid bitGrid(2, 2);
+    bitGrid.setCellValue(0, 1, true);
+
+    storage.addGrid(intGrid);
+    storage.addGrid(bitGrid);
+    CHECK(storage.size() == 1);
+    CHECK(storage[intGrid] == 2);
+}
+
+TEST_CASE("GridStorage counts region views like region grids") {
+    Grid grid(9, 9);
+    for (auto [r, c] : {std::pair<int, int>{0, 1}, {1, 0}, {1, 1}, {5, 6}, {6, 5}, {6, 6}, {8, 0}}) {
+        grid.setCellValue(r, c, 1);
+    }
+    GridStorage storage;
+    std::vector<Grid> regionGrids;
+    for (const Region& region : grid.getNonInteractingRegions()) {
+        storage.addGrid(RegionView(grid, region));
+        regionGrids.push_back(convertRegionToGrid(grid, region));
+    }
+    CHECK(storage.size() == 2);
+    CHECK(storage[regionGrids[0]] == 2); // the same shape twice
+    CHECK(storage[regionGrids[2]] == 1);
+    CHECK(storage.size() == 2);
+}
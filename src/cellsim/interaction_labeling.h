@@ -0,0 +1,194 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <random>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+
+#include "../doctest.h"
+
+#include "cell_buffer.h"
+#include "region.h"
+#include "region_labeling.h"
+#include "run_labeling.h"
+
+// Groups live cells that are at most interactionDistance cells apart (Chebyshev distance),
+// through chains of such cells. Distance 1 is the usual 8-connected labeling.
+// Every live cell is grown to a square of distance x distance cells that starts at the cell and goes down
+// and to the right; two squares touch or overlap exactly when their cells are at most distance apart,
+// so groups are the 8-connected regions of the grown (dilated) grid.
+// Dilation works on whole 64-bit words: a row is ORed with copies of itself shifted by 1, 2, 4, ... columns,
+// then rows are ORed with rows 1, 2, 4, ... above, which is O(log distance) passes over the packed grid.
+// The grown grid is labeled by runs (see RunLengthLabeler), and every live cell gets the label of its square.
+class InteractionRegionLabeler {
+public:
+    explicit InteractionRegionLabeler(int interactionDistance = 1) : interactionDistance(interactionDistance) {
+        if (interactionDistance < 1) {
+            throw std::invalid_argument("Interaction distance must be at least 1");
+        }
+    }
+
+    int getInteractionDistance() const { return interactionDistance; }
+
+    // regions ordered by their first cell, cells of every region in row-major order
+    template <typename ValueT, typename Layout>
+    std::vector<Region> getRegions(const CellBuffer<ValueT, Layout>& cells) const {
+        CellBuffer<bool> live = toLiveMask(cells);
+        RunRegions grown = RunLengthLabeler().label(interactionDistance == 1 ? live : dilate(live, interactionDistance));
+
+        // the first grown cell of every group is the first live cell of it, so order of regions is kept
+        std::vector<Region> regions(grown.regionCount);
+        std::size_t run = 0;
+        for (int r = 0; r < live.getRows(); ++r) {
+            const std::uint64_t* words = live.rowWords(r);
+            for (int w = 0; w < live.getWordsPerRow(); ++w) {
+                for (std::uint64_t word = words[w]; word != 0; word &= word - 1) {
+                    int c = w * 64 + countTrailingZeros(word);
+                    // every live cell is inside a grown run of its own row
+                    while (grown.runs[run].row < r || grown.runs[run].colEnd <= c) {
+                        run++;
+                    }
+                    regions[grown.runs[run].label - 1].addCell(r, c, static_cast<std::int64_t>(cells.getValue(r, c)));
+                }
+            }
+        }
+        return regions;
+    }
+
+    // Cells grown to squares of size x size cells that start at them and go down and to the right,
+    // cut at the grid border
+    static CellBuffer<bool> dilate(const CellBuffer<bool>& cells, int size) {
+        CellBuffer<bool> result = cells;
+        int rows = result.getRows();
+        int wordCount = result.getWordsPerRow();
+        if (rows == 0 || wordCount == 0) {
+            return result;
+        }
+        std::uint64_t lastWordMask = result.getCols() % 64 == 0 ? ~std::uint64_t{0}
+                                                                : (std::uint64_t{1} << (result.getCols() % 64)) - 1;
+        for (int r = 0; r < rows; ++r) {
+            std::uint64_t* words = result.rowWords(r);
+            // after each step the row covers shifts [0, covered)
+            for (int covered = 1; covered < size;) {
+                int step = std::min(covered, size - covered);
+                orShiftedRight(words, wordCount, step);
+                covered += step;
+            }
+            words[wordCount - 1] &= lastWordMask;
+        }
+        for (int covered = 1; covered < size;) {
+            int step = std::min(covered, size - covered);
+            // from the bottom, so rows above are read before they change
+            for (int r = rows - 1; r >= step; --r) {
+                std::uint64_t* words = result.rowWords(r);
+                const std::uint64_t* above = result.rowWords(r - step);
+                for (int w = 0; w < wordCount; ++w) {
+                    words[w] |= above[w];
+                }
+            }
+            covered += step;
+        }
+        return result;
+    }
+
+private:
+    template <typename ValueT, typename Layout>
+    static CellBuffer<bool> toLiveMask(const CellBuffer<ValueT, Layout>& cells) {
+        if constexpr (std::is_same_v<CellBuffer<ValueT, Layout>, CellBuffer<bool>>) {
+            return cells;
+        } else {
+            CellBuffer<bool> live(cells.getRows(), cells.getCols());
+            for (int r = 0; r < cells.getRows(); ++r) {
+                for (int c = 0; c < cells.getCols(); ++c) {
+                    if (cells.getValue(r, c) != 0) {
+                        live.setValue(r, c, true);
+                    }
+                }
+            }
+            return live;
+        }
+    }
+
+    // words |= words moved shift columns towards higher columns;
+    // goes from the last word, so every word is read before it changes
+    static void orShiftedRight(std::uint64_t* words, int wordCount, int shift) {
+        int wordShift = shift / 64;
+        int bitShift = shift % 64;
+        for (int w = wordCount - 1; w >= wordShift; --w) {
+            std::uint64_t moved = words[w - wordShift] << bitShift;
+            if (bitShift != 0 && w - wordShift > 0) {
+                moved |= words[w - wordShift - 1] >> (64 - bitShift);
+            }
+            words[w] |= moved;
+        }
+    }
+
+    int interactionDistance;
+};
+
+TEST_CASE("dilation grows cells to squares") {
+    CellBuffer<bool> cells(6, 140);
+    cells.setValue(1, 62, true);
+    cells.setValue(4, 138, true);
+    CellBuffer<bool> grown = InteractionRegionLabeler::dilate(cells, 3);
+    bool squaresMatch = true;
+    for (int r = 0; r < 6; ++r) {
+        for (int c = 0; c < 140; ++c) {
+            bool expected = (r >= 1 && r <= 3 && c >= 62 && c <= 64) || (r >= 4 && c >= 138);
+            squaresMatch = squaresMatch && grown.getValue(r, c) == expected;
+        }
+    }
+    CHECK(squaresMatch);
+    CHECK(InteractionRegionLabeler::dilate(cells, 1) == cells);
+    CHECK_THROWS_AS(InteractionRegionLabeler(0), std::invalid_argument);
+}
+
+TEST_CASE("interaction labeling groups cells within distance") {
+    CellBuffer<int> cells(45, 150);
+    std::mt19937 random(11);
+    std::bernoulli_distribution alive(0.015);
+    std::vector<std::pair<int, int>> live;
+    for (int r = 0; r < 45; ++r) {
+        for (int c = 0; c < 150; ++c) {
+            if (alive(random)) {
+                cells.setValue(r, c, 1);
+                live.emplace_back(r, c);
+            }
+        }
+    }
+    for (int distance : {1, 2, 3, 5, 8, 70}) {
+        // every pair of live cells within distance, cells are numbered in raster order
+        UnionFind sets;
+        for (std::size_t i = 0; i < live.size(); ++i) {
+            sets.add();
+        }
+        for (std::size_t i = 0; i < live.size(); ++i) {
+            for (std::size_t j = i + 1; j < live.size(); ++j) {
+                if (std::max(std::abs(live[i].first - live[j].first), std::abs(live[i].second - live[j].second)) <= distance) {
+                    sets.unite(static_cast<int>(i), static_cast<int>(j));
+                }
+            }
+        }
+        std::vector<int> regionOfRoot(live.size(), -1);
+        std::vector<Region> expected;
+        for (std::size_t i = 0; i < live.size(); ++i) {
+            int root = sets.find(static_cast<int>(i));
+            if (regionOfRoot[root] < 0) {
+                regionOfRoot[root] = static_cast<int>(expected.size());
+                expected.emplace_back();
+            }
+            expected[regionOfRoot[root]].addCell(live[i].first, live[i].second);
+        }
+
+        std::vector<Region> regions = InteractionRegionLabeler(distance).getRegions(cells);
+        REQUIRE(regions.size() == expected.size());
+        bool regionsMatch = true;
+        for (std::size_t i = 0; i < regions.size(); ++i) {
+            regionsMatch = regionsMatch && regions[i].getCoordinates() == expected[i].getCoordinates();
+        }
+        CHECK(regionsMatch);
+    }
+}
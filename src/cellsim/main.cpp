@@ -5,7 +5,18 @@
 #include "../doctest.h"
 
 #include "grid.h"
+#include "compact_region.h"
 #include "grid_storage.h"
+#include "region_view.h"
+#include "region_tracking.h"
+#include "region_verification.h"
+#include "grid_history.h"
+#include "mapped_grid.h"
+#include "streaming_update.h"
+#include "spatial_index.h"
+#include "distance_transform.h"
+#include "parallel.h"
+#include "benchmarks.h"
 
 int main(int argc, char** argv) {
     doctest::Context context;
@@ -46,18 +57,23 @@ int main(int argc, char** argv) {
         grid.printRegions(regions);
 
 
-        std::string previousState;
-        std::string stateBeforePrevious;
+        // snapshots of consecutive generations share tiles that did not change
+        GridSnapshot<int> previousState;
+        GridSnapshot<int> stateBeforePrevious;
+        // regions of every generation, found again only where cells changed
+        RegionTracker tracker(grid);
+        std::vector<CellChange<int>> changes;
         
         for (int generation = 0; generation < 30; ++generation) {
-            std::cout << "Generation " << generation << ":\n";
+            std::cout << "Generation " << generation << " (regions: " << tracker.getRegionCount() << "):\n";
             grid.printGrid();
-            bool hasChanged = grid.update();
+            bool hasChanged = grid.update(changes);
+            tracker.update(changes);
             if (!hasChanged) {
                 std::cout<<"simulation ended after " << generation << " steps"<<std::endl;
                 break;
             }
-            std::string currentState = grid.gridToString();
+            GridSnapshot<int> currentState = grid.snapshot(previousState);
             
             // Check for repetition with period 2
             if (generation >= 2 && currentState == stateBeforePrevious) {
@@ -74,14 +90,16 @@ int main(int argc, char** argv) {
         regionsFound = regions.size();
         std::cout<<"Found regions: " << regionsFound<<std::endl;
         grid.printRegions(regions);
-        for (const auto& region: regions) {
+        // every region evolved on its own (in parallel) and compared with the whole grid
+        auto evolutions = verifyRegions(grid, regions, 1);
+        for (std::size_t i = 0; i < regions.size(); ++i) {
             std::cout<<"Region grid"<<std::endl;
-            Grid regionGrid = convertRegionToGrid(grid, region);
-            storage.addGrid(regionGrid);
-            regionGrid.printGrid();
-            std::cout<<"Region grid"<<std::endl;
-            regionGrid.update();
-            regionGrid.printGrid();
+            RegionView regionView(grid, regions[i]); // no copy of cells
+            storage.addGrid(regionView);
+            regionView.print();
+            std::cout<<"Region grid after one generation"
+                     <<(evolutions[i].isIsolated() ? "" : " (interacts with other regions)")<<std::endl;
+            evolutions[i].grid.printGrid();
 
         }
     }
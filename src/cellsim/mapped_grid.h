@@ -0,0 +1,371 @@
+#pragma once
+
+#if defined(__linux__)
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "../doctest.h"
+
+#include "cell_buffer.h"
+#include "grid.h"
+#include "update.h"
+
+// Binary file of a grid that is used directly as its memory.
+//
+// Layout of the file (numbers in native byte order, little-endian on x86 and ARM):
+//   offset 0:    header (MappedGridHeader below), padded with zeros to 4096 bytes
+//   offset 4096: buffer 0 - storage of CellBuffer<ValueT> in row-major order:
+//                ValueT for every cell, or for bool cells 64-bit words, each row starting with a new word
+//                (bit c % 64 of word c / 64 is the cell in column c)
+//   next offset that is a multiple of 4096: buffer 1 - the same for the other generation
+// One buffer holds the current generation, update() writes the next generation into the other one,
+// writes it to disk, and only then switches header.currentBuffer and writes the header page.
+// So after a crash during update() the header still points at the previous complete generation.
+struct MappedGridHeader {
+    char magic[8];                // "CELLGRID"
+    std::uint32_t version;        // 1
+    std::uint32_t cellBits;       // bits per cell: 1 for bool, 8 * sizeof(ValueT) otherwise
+    std::int32_t rows;
+    std::int32_t cols;
+    std::uint64_t generation;     // number of updates made since the file was created
+    std::uint32_t currentBuffer;  // 0 or 1
+    std::uint32_t reserved;
+    std::uint64_t bufferOffset[2];
+    std::uint64_t bufferBytes;
+};
+
+static_assert(std::is_standard_layout_v<MappedGridHeader> && sizeof(MappedGridHeader) == 64,
+              "header layout is part of the file format");
+
+// Grid stored in a memory-mapped file.
+// Opening takes the same time for any file size: nothing is read, pages are loaded
+// by the OS when cells are accessed for the first time. Changes go to the file, flush() forces them to disk.
+// It is a separate class with only the basic cell access and update(), not a BasicGrid;
+// toGrid() copies the cells to use the rest of the grid functions.
+template <typename ValueT>
+class MappedGrid {
+public:
+    static constexpr std::size_t pageSize = 4096;
+    static constexpr char magic[8] = {'C', 'E', 'L', 'L', 'G', 'R', 'I', 'D'};
+
+    // creates new file with all cells 0 (existing file is replaced)
+    static MappedGrid create(const std::string& path, int rows, int cols) {
+        if (rows < 0 || cols < 0) {
+            throw std::invalid_argument("Grid size can't be negative");
+        }
+        MappedGridHeader newHeader = makeHeader(rows, cols);
+        std::size_t fileSize = getFileSize(newHeader);
+
+        int file = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+        if (file < 0) {
+            throw std::runtime_error("Can't create grid file " + path);
+        }
+        if (ftruncate(file, static_cast<off_t>(fileSize)) != 0) { // new file is sparse and filled with zeros
+            ::close(file);
+            throw std::runtime_error("Can't resize grid file " + path);
+        }
+
+        MappedGrid grid(file, fileSize);
+        grid.header() = newHeader;
+        grid.attachBuffers();
+        return grid;
+    }
+
+    // opens existing file; throws std::runtime_error if it is missing or has another format or cell type
+    static MappedGrid open(const std::string& path) {
+        int file = ::open(path.c_str(), O_RDWR);
+        if (file < 0) {
+            throw std::runtime_error("Can't open grid file " + path);
+        }
+        struct stat status;
+        if (fstat(file, &status) != 0 || static_cast<std::size_t>(status.st_size) < pageSize) {
+            ::close(file);
+            throw std::runtime_error("Not a grid file: " + path);
+        }
+
+        MappedGrid grid(file, static_cast<std::size_t>(status.st_size));
+        checkHeader(grid.header(), grid.mappedBytes, path);
+        grid.attachBuffers();
+        return grid;
+    }
+
+    // header of a new file with rows x cols cells, generation 0 in buffer 0
+    static MappedGridHeader makeHeader(int rows, int cols) {
+        std::size_t bufferBytes = CellBuffer<ValueT>::storageSize(rows, cols)
+                                  * sizeof(typename CellBuffer<ValueT>::StorageType);
+        MappedGridHeader header{};
+        std::memcpy(header.magic, magic, sizeof(magic));
+        header.version = 1;
+        header.cellBits = cellBits();
+        header.rows = rows;
+        header.cols = cols;
+        header.generation = 0;
+        header.currentBuffer = 0;
+        header.bufferOffset[0] = pageSize;
+        header.bufferOffset[1] = pageSize + roundUpToPage(bufferBytes);
+        header.bufferBytes = bufferBytes;
+        return header;
+    }
+
+    // size of a file made with makeHeader()
+    static std::size_t getFileSize(const MappedGridHeader& header) {
+        return header.bufferOffset[1] + roundUpToPage(header.bufferBytes);
+    }
+
+    // throws std::runtime_error if header does not describe a file of fileSize bytes with ValueT cells
+    static void checkHeader(const MappedGridHeader& header, std::size_t fileSize, const std::string& path) {
+        if (std::memcmp(header.magic, magic, sizeof(magic)) != 0 || header.version != 1) {
+            throw std::runtime_error("Not a grid file: " + path);
+        }
+        if (header.cellBits != cellBits()) {
+            throw std::runtime_error("Grid file has another cell type: " + path);
+        }
+        if (header.rows < 0 || header.cols < 0) {
+            throw std::runtime_error("Grid file is damaged: " + path);
+        }
+        std::size_t bufferBytes = CellBuffer<ValueT>::storageSize(header.rows, header.cols)
+                                  * sizeof(typename CellBuffer<ValueT>::StorageType);
+        if (header.bufferBytes != bufferBytes || header.currentBuffer > 1) {
+            throw std::runtime_error("Grid file is damaged: " + path);
+        }
+        // buffers are mapped as whole pages, after the header page, and must not overlap
+        std::uint64_t first = std::min(header.bufferOffset[0], header.bufferOffset[1]);
+        std::uint64_t second = std::max(header.bufferOffset[0], header.bufferOffset[1]);
+        for (std::uint64_t offset : header.bufferOffset) {
+            if (offset % pageSize != 0 || offset < pageSize || offset > fileSize || bufferBytes > fileSize - offset) {
+                throw std::runtime_error("Grid file is damaged: " + path);
+            }
+        }
+        if (second - first < roundUpToPage(bufferBytes)) {
+            throw std::runtime_error("Grid file is damaged: " + path);
+        }
+    }
+
+    MappedGrid(MappedGrid&& other) noexcept
+        : file(std::exchange(other.file, -1)), mappedBytes(std::exchange(other.mappedBytes, 0)),
+          memory(std::exchange(other.memory, nullptr)),
+          buffers{std::move(other.buffers[0]), std::move(other.buffers[1])} {}
+
+    MappedGrid& operator=(MappedGrid&& other) noexcept {
+        if (this != &other) {
+            release();
+            file = std::exchange(other.file, -1);
+            mappedBytes = std::exchange(other.mappedBytes, 0);
+            memory = std::exchange(other.memory, nullptr);
+            buffers[0] = std::move(other.buffers[0]);
+            buffers[1] = std::move(other.buffers[1]);
+        }
+        return *this;
+    }
+
+    MappedGrid(const MappedGrid&) = delete;
+    MappedGrid& operator=(const MappedGrid&) = delete;
+
+    ~MappedGrid() {
+        release();
+    }
+
+    int getRows() const { return header().rows; }
+
+    int getCols() const { return header().cols; }
+
+    std::uint64_t getGeneration() const { return header().generation; }
+
+    bool isValidCoordinates(int row, int col) const {
+        return row >= 0 && row < getRows() && col >= 0 && col < getCols();
+    }
+
+    ValueT getCellValue(int row, int col) const {
+        if (!isValidCoordinates(row, col)) {
+            throw std::out_of_range("Cell index out of range");
+        }
+        return getCells().getValue(row, col);
+    }
+
+    void setCellValue(int row, int col, ValueT value) {
+        if (!isValidCoordinates(row, col)) {
+            throw std::out_of_range("Cell index out of range");
+        }
+        currentCells().setValue(row, col, value);
+    }
+
+    // cells of the current generation (they are in the file, not copied)
+    const CellBuffer<ValueT>& getCells() const {
+        return buffers[header().currentBuffer];
+    }
+
+    // Writes next generation into the other buffer of the file and makes it current.
+    // The new buffer is on disk before the header that points at it, so the file always has a complete generation.
+    // Returns true if any cell changed.
+    bool update() {
+        MappedGridHeader& fileHeader = header();
+        std::uint32_t next = 1 - fileHeader.currentBuffer;
+        const CellBuffer<ValueT>& cells = buffers[fileHeader.currentBuffer];
+        CellBuffer<ValueT>& newCells = buffers[next];
+        bool hasChanged = Updater().updateRows(cells, newCells, 0, cells.getRows());
+        sync(fileHeader.bufferOffset[next], fileHeader.bufferBytes);
+        fileHeader.currentBuffer = next;
+        fileHeader.generation++;
+        sync(0, sizeof(MappedGridHeader));
+        return hasChanged;
+    }
+
+    // Writes changed pages to disk and waits until it is done
+    void flush() {
+        if (msync(memory, mappedBytes, MS_SYNC) != 0) {
+            throw std::runtime_error("Can't write grid file");
+        }
+    }
+
+    // copy of the current generation in memory
+    BasicGrid<ValueT> toGrid() const {
+        return BasicGrid<ValueT>(CellBuffer<ValueT>(getCells()));
+    }
+
+private:
+    MappedGrid(int file, std::size_t bytes) : file(file), mappedBytes(bytes), memory(nullptr) {
+        void* pointer = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, file, 0);
+        if (pointer == MAP_FAILED) {
+            ::close(file);
+            this->file = -1;
+            throw std::runtime_error("Can't map grid file");
+        }
+        memory = static_cast<char*>(pointer);
+    }
+
+    // writes pages of bytes at offset of the file to disk and waits until it is done; offset is a multiple of pageSize
+    void sync(std::size_t offset, std::size_t bytes) {
+        if (bytes != 0 && msync(memory + offset, bytes, MS_SYNC) != 0) {
+            throw std::runtime_error("Can't write grid file");
+        }
+    }
+
+    static std::size_t roundUpToPage(std::size_t bytes) {
+        return (bytes + pageSize - 1) / pageSize * pageSize;
+    }
+
+    static std::uint32_t cellBits() {
+        return std::is_same_v<ValueT, bool> ? 1 : 8 * sizeof(ValueT);
+    }
+
+    MappedGridHeader& header() {
+        return *reinterpret_cast<MappedGridHeader*>(memory);
+    }
+
+    const MappedGridHeader& header() const {
+        return *reinterpret_cast<const MappedGridHeader*>(memory);
+    }
+
+    CellBuffer<ValueT>& currentCells() {
+        return buffers[header().currentBuffer];
+    }
+
+    void attachBuffers() {
+        using StorageType = typename CellBuffer<ValueT>::StorageType;
+        const MappedGridHeader& fileHeader = header();
+        std::size_t size = CellBuffer<ValueT>::storageSize(fileHeader.rows, fileHeader.cols);
+        for (int i = 0; i < 2; ++i) {
+            auto* storage = reinterpret_cast<StorageType*>(memory + fileHeader.bufferOffset[i]);
+            buffers[i] = CellBuffer<ValueT>(fileHeader.rows, fileHeader.cols, GridArray<StorageType>::view(storage, size));
+        }
+    }
+
+    void release() {
+        buffers[0] = CellBuffer<ValueT>();
+        buffers[1] = CellBuffer<ValueT>();
+        if (memory != nullptr) {
+            munmap(memory, mappedBytes);
+            memory = nullptr;
+        }
+        if (file >= 0) {
+            ::close(file);
+            file = -1;
+        }
+    }
+
+    int file;
+    std::size_t mappedBytes;
+    char* memory;
+    CellBuffer<ValueT> buffers[2]; // views of the two buffers in the file
+};
+
+TEST_CASE("MappedGrid keeps generations in file") {
+    const std::string filename = "test_mapped_grid.bin";
+    {
+        MappedGrid<int> grid = MappedGrid<int>::create(filename, 5, 5);
+        CHECK(grid.getRows() == 5);
+        CHECK(grid.getCellValue(2, 2) == 0);
+        // vertical blinker
+        grid.setCellValue(1, 2, 1);
+        grid.setCellValue(2, 2, 1);
+        grid.setCellValue(3, 2, 1);
+        CHECK(grid.update());
+        grid.flush();
+        CHECK_THROWS_AS(grid.setCellValue(5, 0, 1), std::out_of_range);
+    }
+    {
+        MappedGrid<int> grid = MappedGrid<int>::open(filename);
+        CHECK(grid.getGeneration() == 1);
+        CHECK(grid.getCellValue(2, 1) == 1); // horizontal now
+        CHECK(grid.getCellValue(2, 3) == 1);
+        CHECK(grid.getCellValue(1, 2) == 0);
+
+        Grid copy = grid.toGrid();
+        CHECK(grid.update());
+        copy.update();
+        CHECK(grid.toGrid().gridToString() == copy.gridToString());
+    }
+    CHECK_THROWS_AS(MappedGrid<std::uint8_t>::open(filename), std::runtime_error); // another cell type
+
+    MappedGridHeader header = MappedGrid<int>::makeHeader(5, 5);
+    std::size_t fileSize = MappedGrid<int>::getFileSize(header);
+    CHECK_NOTHROW(MappedGrid<int>::checkHeader(header, fileSize, filename));
+    MappedGridHeader damaged = header;
+    damaged.bufferOffset[0] = 100; // not page-aligned
+    CHECK_THROWS_AS(MappedGrid<int>::checkHeader(damaged, fileSize, filename), std::runtime_error);
+    damaged.bufferOffset[0] = 0; // over the header
+    CHECK_THROWS_AS(MappedGrid<int>::checkHeader(damaged, fileSize, filename), std::runtime_error);
+    damaged.bufferOffset[0] = header.bufferOffset[1]; // same as the other buffer
+    CHECK_THROWS_AS(MappedGrid<int>::checkHeader(damaged, fileSize, filename), std::runtime_error);
+
+    std::remove(filename.c_str());
+    CHECK_THROWS_AS(MappedGrid<int>::open(filename), std::runtime_error);
+}
+
+TEST_CASE("MappedGrid with bit-packed cells") {
+    const std::string filename = "test_mapped_bit_grid.bin";
+    {
+        MappedGrid<bool> grid = MappedGrid<bool>::create(filename, 3, 100);
+        grid.setCellValue(1, 97, true);
+        grid.setCellValue(1, 98, true);
+        grid.setCellValue(1, 99, true);
+        grid.flush();
+    }
+    {
+        MappedGrid<bool> grid = MappedGrid<bool>::open(filename);
+        CHECK(grid.getCellValue(1, 98));
+        CHECK(!grid.getCellValue(0, 98));
+        grid.update();
+        CHECK(grid.getCellValue(0, 98));
+        CHECK(grid.getCellValue(2, 98));
+        CHECK(!grid.getCellValue(1, 97));
+
+        MappedGrid<bool> moved = std::move(grid);
+        CHECK(moved.getCellValue(0, 98));
+    }
+    std::remove(filename.c_str());
+}
+
+#endif
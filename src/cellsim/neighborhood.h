@@ -0,0 +1,442 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include "../doctest.h"
+
+#include "parallel.h"
+
+enum class DistanceType {
+    Euclidean,
+    Manhattan,
+    Chebyshev
+};
+
+// std::abs is not constexpr before C++23
+constexpr std::int64_t absoluteValue(std::int64_t value) {
+    return value < 0 ? -value : value;
+}
+
+// true if cell at offset (rowOffset, colOffset) from the center is within distance from it.
+// Euclidean distance is compared squared, so no floating point is needed and the result is exact.
+// Computed in 64 bits: squares and sums of any int values fit, offsets between two int positions too.
+constexpr bool isWithinDistance(std::int64_t rowOffset, std::int64_t colOffset, DistanceType distanceType,
+                                std::int64_t distance) {
+    switch (distanceType) {
+        case DistanceType::Euclidean:
+            return rowOffset * rowOffset + colOffset * colOffset <= distance * distance;
+        case DistanceType::Manhattan:
+            return absoluteValue(rowOffset) + absoluteValue(colOffset) <= distance;
+        case DistanceType::Chebyshev:
+            return absoluteValue(rowOffset) <= distance && absoluteValue(colOffset) <= distance;
+    }
+    return false;
+}
+
+struct StencilOffset {
+    int row;
+    int col;
+};
+
+constexpr std::size_t countStencilOffsets(DistanceType distanceType, int distance) {
+    std::size_t count = 0;
+    for (int r = -distance; r <= distance; ++r) {
+        for (int c = -distance; c <= distance; ++c) {
+            count += isWithinDistance(r, c, distanceType, distance);
+        }
+    }
+    return count;
+}
+
+template <DistanceType Type, int Distance, std::size_t Size>
+constexpr std::array<StencilOffset, Size> makeStencilOffsets() {
+    std::array<StencilOffset, Size> offsets{};
+    std::size_t count = 0;
+    for (int r = -Distance; r <= Distance; ++r) {
+        for (int c = -Distance; c <= Distance; ++c) {
+            if (isWithinDistance(r, c, Type, Distance)) {
+                offsets[count++] = StencilOffset{r, c};
+            }
+        }
+    }
+    return offsets;
+}
+
+// Neighborhood with shape known at compile time: the same offsets as NeighborhoodStencils::get(Type, Distance),
+// but in a constexpr array. Code templated on it has a loop of fixed length that the compiler unrolls.
+template <DistanceType Type, int Distance>
+struct StaticNeighborhood {
+    static_assert(Distance >= 0, "distance can't be negative");
+
+    static constexpr DistanceType distanceType = Type;
+    static constexpr int distance = Distance;
+    static constexpr std::size_t size = countStencilOffsets(Type, Distance);
+    static constexpr std::array<StencilOffset, size> offsets = makeStencilOffsets<Type, Distance, size>();
+};
+
+// 3 x 3 square, used by the Game of Life rule
+using MooreNeighborhood = StaticNeighborhood<DistanceType::Chebyshev, 1>;
+
+template <int Distance>
+using VonNeumannNeighborhood = StaticNeighborhood<DistanceType::Manhattan, Distance>;
+
+// Offsets (row, column) of all cells within distance from the center, the center included,
+// in row-major order. Stencils of every type up to maxDistance are built together on first use
+// into a table that never changes, so all calculators and threads read it without locking.
+class NeighborhoodStencils {
+public:
+    using Stencil = std::vector<std::pair<int, int>>;
+
+    static constexpr int maxDistance = 16;
+
+    // stencil from the table, or nullptr if distance is larger than maxDistance;
+    // returned pointer stays valid until the program ends
+    static const Stencil* find(DistanceType distanceType, int distance) {
+        static const Stencil none;
+        if (distance < 0) {
+            return &none;
+        }
+        if (distance > maxDistance) {
+            return nullptr;
+        }
+        // built by the first caller; C++ makes other threads wait for it, later calls take no lock
+        static const std::vector<Stencil> table = buildTable();
+        return &table[static_cast<std::size_t>(distanceType) * (maxDistance + 1) + distance];
+    }
+
+    // throws std::out_of_range if distance is larger than maxDistance
+    static const Stencil& get(DistanceType distanceType, int distance) {
+        const Stencil* stencil = find(distanceType, distance);
+        if (stencil == nullptr) {
+            throw std::out_of_range("Neighborhood distance is too large for the stencil table");
+        }
+        return *stencil;
+    }
+
+    static Stencil build(DistanceType distanceType, int distance) {
+        Stencil stencil;
+        for (int r = -distance; r <= distance; ++r) {
+            for (int c = -distance; c <= distance; ++c) {
+                if (isWithinDistance(r, c, distanceType, distance)) {
+                    stencil.emplace_back(r, c);
+                }
+            }
+        }
+        return stencil;
+    }
+
+private:
+    // stencil of type t and distance d is at index t * (maxDistance + 1) + d
+    static std::vector<Stencil> buildTable() {
+        std::vector<Stencil> table;
+        for (DistanceType type : {DistanceType::Euclidean, DistanceType::Manhattan, DistanceType::Chebyshev}) {
+            for (int distance = 0; distance <= maxDistance; ++distance) {
+                table.push_back(build(type, distance));
+            }
+        }
+        return table;
+    }
+};
+
+// Neighborhoods of many cells in compressed sparse row (CSR) form, stored in a single array:
+// neighbors of center i are cell indexes (row * cols + col) from getBegin(i) to getEnd(i),
+// in the same order as getNeighborhoodByDistance() returns them.
+class NeighborhoodLists {
+public:
+    std::size_t getCenterCount() const { return centerCount; }
+
+    // total number of neighbors of all centers
+    std::size_t getNeighborCount() const { return storage.empty() ? 0 : storage.size() - (centerCount + 1); }
+
+    const std::size_t* getBegin(std::size_t center) const { return getNeighbors() + storage[center]; }
+
+    const std::size_t* getEnd(std::size_t center) const { return getNeighbors() + storage[center + 1]; }
+
+    std::size_t getSize(std::size_t center) const { return storage[center + 1] - storage[center]; }
+
+    // list of center i is [offsets[i], offsets[i + 1]) of getNeighbors(); both are null for default-made lists
+    const std::size_t* getOffsets() const { return storage.data(); }
+
+    const std::size_t* getNeighbors() const { return storage.empty() ? nullptr : storage.data() + centerCount + 1; }
+
+private:
+    friend class NeighborhoodCalculator;
+
+    std::size_t centerCount = 0;
+    std::vector<std::size_t> storage; // centerCount + 1 offsets, then all neighbor indexes
+};
+
+// Calculator has only the grid dimensions, so it is cheap to make for every query
+// and can be used by several threads at once.
+class NeighborhoodCalculator {
+public:
+    // Constructor to accept grid dimensions (could be extended for different grids)
+    NeighborhoodCalculator(int rows, int cols) : rows(rows), cols(cols) {}
+
+    // Calls visit(neighborRow, neighborCol) for every cell within distance from (row, col), in row-major order.
+    // Up to NeighborhoodStencils::maxDistance the stencil comes from the table and nothing is allocated;
+    // a larger distance builds its stencil on every call. A lambda passed as visitor is inlined into the loop.
+    // Stencil is clipped by the grid edges; far from edges no cell needs checking.
+    template <typename Visitor>
+    void forEachInNeighborhood(int row, int col, DistanceType distanceType, int distance, Visitor&& visit) const {
+        NeighborhoodStencils::Stencil built;
+        visitStencil(getStencil(distanceType, distance, built), distance, row, col, visit);
+    }
+
+    // Same for a compile-time neighborhood, for example forEachInNeighborhood<MooreNeighborhood>(row, col, visit).
+    // Far from edges all offsets are visited by unrolled code without any checks.
+    template <typename Neighborhood, typename Visitor>
+    void forEachInNeighborhood(int row, int col, Visitor&& visit) const {
+        constexpr int distance = Neighborhood::distance;
+        if (row - distance >= 0 && row + distance < rows && col - distance >= 0 && col + distance < cols) {
+            visitAll<Neighborhood>(row, col, visit, std::make_index_sequence<Neighborhood::size>());
+            return;
+        }
+        for (const StencilOffset& offset : Neighborhood::offsets) {
+            int newRow = row + offset.row;
+            int newCol = col + offset.col;
+            if (newRow >= 0 && newRow < rows && newCol >= 0 && newCol < cols) {
+                visit(newRow, newCol);
+            }
+        }
+    }
+
+    // forEachInNeighborhood() for immediate neighbors (Chebyshev distance 1), the cell itself included
+    template <typename Visitor>
+    void forEachNeighbor(int row, int col, Visitor&& visit) const {
+        forEachInNeighborhood<MooreNeighborhood>(row, col, std::forward<Visitor>(visit));
+    }
+
+    // Function to calculate the neighborhood based on distance type and distance
+    std::vector<std::pair<int, int>> getNeighborhoodByDistance(int row, int col,
+                                                                DistanceType distanceType,
+                                                                int distance) const {
+        NeighborhoodStencils::Stencil built;
+        const NeighborhoodStencils::Stencil& stencil = getStencil(distanceType, distance, built);
+        std::vector<std::pair<int, int>> neighborhood;
+        neighborhood.reserve(stencil.size());
+        visitStencil(stencil, distance, row, col, [&](int newRow, int newCol) {
+            neighborhood.emplace_back(newRow, newCol);
+        });
+        return neighborhood;
+    }
+
+    // A simpler interface for getting immediate neighbors (Chebyshev distance 1)
+    std::vector<std::pair<int, int>> getNeighbors(int row, int col) const {
+        return getNeighborhoodByDistance(row, col, DistanceType::Chebyshev, 1);
+    }
+
+    // Neighborhoods of all centers at once, as one CSR structure (see NeighborhoodLists).
+    // With threadCount > 1 centers are split between threads; the result does not depend on it.
+    NeighborhoodLists getNeighborhoods(const std::vector<std::pair<int, int>>& centers, DistanceType distanceType,
+                                       int distance, int threadCount = 1) const {
+        NeighborhoodStencils::Stencil built;
+        const NeighborhoodStencils::Stencil& stencil = getStencil(distanceType, distance, built);
+        int centerCount = static_cast<int>(centers.size());
+
+        // first pass counts neighbors of every center, to know the total size and where every list starts
+        std::vector<std::size_t> counts(centers.size());
+        parallelFor(0, centerCount, threadCount, [&](int, int begin, int end) {
+            for (int i = begin; i < end; ++i) {
+                std::size_t count = 0;
+                visitStencil(stencil, distance, centers[i].first, centers[i].second, [&](int, int) { count++; });
+                counts[i] = count;
+            }
+        });
+        std::size_t total = 0;
+        for (std::size_t count : counts) {
+            total += count;
+        }
+
+        // storage is allocated once with its final size; second pass writes every list into its place
+        std::size_t offsetCount = centers.size() + 1;
+        NeighborhoodLists lists;
+        lists.centerCount = centers.size();
+        lists.storage.resize(offsetCount + total);
+        std::size_t* offsets = lists.storage.data();
+        std::size_t* neighbors = offsets + offsetCount;
+        offsets[0] = 0;
+        for (std::size_t i = 0; i < centers.size(); ++i) {
+            offsets[i + 1] = offsets[i] + counts[i];
+        }
+        parallelFor(0, centerCount, threadCount, [&](int, int begin, int end) {
+            for (int i = begin; i < end; ++i) {
+                std::size_t position = offsets[i];
+                visitStencil(stencil, distance, centers[i].first, centers[i].second, [&](int newRow, int newCol) {
+                    neighbors[position++] = static_cast<std::size_t>(newRow) * cols + newCol;
+                });
+            }
+        });
+        return lists;
+    }
+
+private:
+    // visits cells of the stencil around (row, col) that are within the grid
+    template <typename Visitor>
+    void visitStencil(const NeighborhoodStencils::Stencil& stencil, int distance, int row, int col,
+                      Visitor&& visit) const {
+        bool isInside = row - distance >= 0 && row + distance < rows && col - distance >= 0 && col + distance < cols;
+        for (const auto& [r, c] : stencil) {
+            int newRow = row + r;
+            int newCol = col + c;
+
+            // Check if the new position is within bounds
+            if (isInside || (newRow >= 0 && newRow < rows && newCol >= 0 && newCol < cols)) {
+                visit(newRow, newCol);
+            }
+        }
+    }
+
+    template <typename Neighborhood, typename Visitor, std::size_t... Indexes>
+    static void visitAll(int row, int col, Visitor& visit, std::index_sequence<Indexes...>) {
+        (visit(row + Neighborhood::offsets[Indexes].row, col + Neighborhood::offsets[Indexes].col), ...);
+    }
+
+    // Stencil from the table; a larger one is built into built. That happens only for
+    // distances above NeighborhoodStencils::maxDistance, where the query itself visits hundreds of cells.
+    static const NeighborhoodStencils::Stencil& getStencil(DistanceType distanceType, int distance,
+                                                           NeighborhoodStencils::Stencil& built) {
+        if (const NeighborhoodStencils::Stencil* stencil = NeighborhoodStencils::find(distanceType, distance)) {
+            return *stencil;
+        }
+        built = NeighborhoodStencils::build(distanceType, distance);
+        return built;
+    }
+
+    int rows;
+    int cols;
+};
+
+TEST_CASE("neighborhood stencils") {
+    CHECK(NeighborhoodStencils::get(DistanceType::Chebyshev, 1).size() == 9);
+    CHECK(NeighborhoodStencils::get(DistanceType::Manhattan, 2).size() == 13);
+    CHECK(NeighborhoodStencils::get(DistanceType::Euclidean, 2).size() == 13);
+    CHECK(NeighborhoodStencils::get(DistanceType::Euclidean, 3).size() == 29);
+    CHECK(NeighborhoodStencils::get(DistanceType::Chebyshev, 0) == NeighborhoodStencils::Stencil{{0, 0}});
+    CHECK(NeighborhoodStencils::get(DistanceType::Chebyshev, -1).empty());
+
+    // built once
+    CHECK(&NeighborhoodStencils::get(DistanceType::Euclidean, 3) == &NeighborhoodStencils::get(DistanceType::Euclidean, 3));
+    int tooFar = NeighborhoodStencils::maxDistance + 1;
+    CHECK(NeighborhoodStencils::find(DistanceType::Euclidean, tooFar) == nullptr);
+    CHECK_THROWS_AS(NeighborhoodStencils::get(DistanceType::Euclidean, tooFar), std::out_of_range);
+
+    // calculator builds stencils that are not in the table
+    NeighborhoodCalculator calculator(tooFar + 1, 3);
+    CHECK(calculator.getNeighborhoodByDistance(0, 0, DistanceType::Chebyshev, tooFar).size()
+          == static_cast<std::size_t>((tooFar + 1) * 3));
+
+    // row-major order
+    const auto& manhattan = NeighborhoodStencils::get(DistanceType::Manhattan, 1);
+    CHECK(manhattan == NeighborhoodStencils::Stencil{{-1, 0}, {0, -1}, {0, 0}, {0, 1}, {1, 0}});
+}
+
+TEST_CASE("clipped stencil gives the same cells as scanning the box") {
+    NeighborhoodCalculator calculator(6, 8);
+    for (DistanceType type : {DistanceType::Euclidean, DistanceType::Manhattan, DistanceType::Chebyshev}) {
+        for (int distance = 0; distance <= 4; ++distance) {
+            bool allMatch = true;
+            for (int row = 0; row < 6; ++row) {
+                for (int col = 0; col < 8; ++col) {
+                    std::vector<std::pair<int, int>> expected;
+                    for (int r = row - distance; r <= row + distance; ++r) {
+                        for (int c = col - distance; c <= col + distance; ++c) {
+                            if (r >= 0 && r < 6 && c >= 0 && c < 8
+                                && isWithinDistance(r - row, c - col, type, distance)) {
+                                expected.emplace_back(r, c);
+                            }
+                        }
+                    }
+                    allMatch = allMatch && calculator.getNeighborhoodByDistance(row, col, type, distance) == expected;
+                }
+            }
+            CHECK(allMatch);
+        }
+    }
+}
+
+TEST_CASE("neighborhood visitor visits the same cells as the vector query") {
+    NeighborhoodCalculator calculator(5, 5);
+    std::vector<std::pair<int, int>> visited;
+    calculator.forEachInNeighborhood(0, 4, DistanceType::Euclidean, 2, [&](int row, int col) {
+        visited.emplace_back(row, col);
+    });
+    CHECK(visited == calculator.getNeighborhoodByDistance(0, 4, DistanceType::Euclidean, 2));
+    CHECK(visited == std::vector<std::pair<int, int>>{{0, 2}, {0, 3}, {0, 4}, {1, 3}, {1, 4}, {2, 4}});
+
+    int count = 0;
+    calculator.forEachNeighbor(2, 2, [&](int, int) { count++; });
+    CHECK(count == 9);
+}
+
+TEST_CASE("compile-time neighborhoods") {
+    static_assert(MooreNeighborhood::size == 9);
+    static_assert(VonNeumannNeighborhood<2>::size == 13);
+    static_assert(StaticNeighborhood<DistanceType::Euclidean, 3>::size == 29);
+    static_assert(MooreNeighborhood::offsets[0].row == -1 && MooreNeighborhood::offsets[0].col == -1);
+
+    // the same offsets as the runtime stencil
+    const auto& stencil = NeighborhoodStencils::get(DistanceType::Manhattan, 2);
+    REQUIRE(stencil.size() == VonNeumannNeighborhood<2>::size);
+    bool offsetsMatch = true;
+    for (std::size_t i = 0; i < stencil.size(); ++i) {
+        offsetsMatch = offsetsMatch && stencil[i].first == VonNeumannNeighborhood<2>::offsets[i].row
+                                    && stencil[i].second == VonNeumannNeighborhood<2>::offsets[i].col;
+    }
+    CHECK(offsetsMatch);
+
+    // and the same clipped cells at every position, near edges and far from them
+    NeighborhoodCalculator calculator(7, 6);
+    bool cellsMatch = true;
+    for (int row = 0; row < 7; ++row) {
+        for (int col = 0; col < 6; ++col) {
+            std::vector<std::pair<int, int>> visited;
+            calculator.forEachInNeighborhood<VonNeumannNeighborhood<2>>(row, col, [&](int r, int c) {
+                visited.emplace_back(r, c);
+            });
+            cellsMatch = cellsMatch && visited == calculator.getNeighborhoodByDistance(row, col, DistanceType::Manhattan, 2);
+        }
+    }
+    CHECK(cellsMatch);
+}
+
+TEST_CASE("batch neighborhood query in CSR form") {
+    NeighborhoodCalculator calculator(6, 7);
+    std::vector<std::pair<int, int>> centers;
+    for (int row = 0; row < 6; ++row) {
+        for (int col = row % 2; col < 7; col += 2) {
+            centers.emplace_back(row, col);
+        }
+    }
+
+    for (int threadCount : {1, 3}) {
+        NeighborhoodLists lists = calculator.getNeighborhoods(centers, DistanceType::Euclidean, 2, threadCount);
+        REQUIRE(lists.getCenterCount() == centers.size());
+        bool listsMatch = true;
+        std::size_t total = 0;
+        for (std::size_t i = 0; i < centers.size(); ++i) {
+            auto expected = calculator.getNeighborhoodByDistance(centers[i].first, centers[i].second,
+                                                                 DistanceType::Euclidean, 2);
+            std::vector<std::pair<int, int>> actual;
+            for (const std::size_t* neighbor = lists.getBegin(i); neighbor != lists.getEnd(i); ++neighbor) {
+                actual.emplace_back(static_cast<int>(*neighbor / 7), static_cast<int>(*neighbor % 7));
+            }
+            listsMatch = listsMatch && actual == expected && lists.getSize(i) == expected.size();
+            total += expected.size();
+        }
+        CHECK(listsMatch);
+        CHECK(lists.getNeighborCount() == total);
+        CHECK(lists.getOffsets()[centers.size()] == total);
+    }
+
+    NeighborhoodLists empty = calculator.getNeighborhoods({}, DistanceType::Chebyshev, 1, 4);
+    CHECK(empty.getCenterCount() == 0);
+    CHECK(empty.getNeighborCount() == 0);
+    CHECK(empty.getOffsets()[0] == 0);
+    CHECK(NeighborhoodLists().getNeighborCount() == 0);
+}
@@ -0,0 +1,277 @@
+#pragma once
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstdint>
+#include <fstream>
+#include <functional>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#include "../doctest.h"
+
+// number of threads to use when caller does not specify it
+inline int defaultThreadCount() {
+    return std::max(1u, std::thread::hardware_concurrency());
+}
+
+// Splits range [begin, end) into threadCount contiguous parts and runs
+// function(worker, partBegin, partEnd) for each part in its own thread.
+// Part of worker i is always the same for the same arguments, so data written by
+// a worker in one call is read by the same worker in the next call.
+template <typename Function>
+void parallelFor(int begin, int end, int threadCount, Function function) {
+    int length = end - begin;
+    threadCount = std::max(1, std::min(threadCount, length));
+    if (threadCount == 1) {
+        function(0, begin, end);
+        return;
+    }
+
+    std::vector<std::thread> threads;
+    for (int worker = 0; worker < threadCount; ++worker) {
+        int partBegin = begin + static_cast<int>(static_cast<long long>(length) * worker / threadCount);
+        int partEnd = begin + static_cast<int>(static_cast<long long>(length) * (worker + 1) / threadCount);
+        threads.emplace_back(function, worker, partBegin, partEnd);
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+}
+
+// Parses list of CPUs in Linux format, for example "0-3,8,10-11"
+inline std::vector<int> parseCpuList(const std::string& list) {
+    std::vector<int> cpus;
+    std::stringstream stream(list);
+    std::string range;
+    while (std::getline(stream, range, ',')) {
+        if (range.empty() || range == "\n") {
+            continue;
+        }
+        size_t dash = range.find('-');
+        int first = std::stoi(range.substr(0, dash));
+        int last = dash == std::string::npos ? first : std::stoi(range.substr(dash + 1));
+        for (int cpu = first; cpu <= last; ++cpu) {
+            cpus.push_back(cpu);
+        }
+    }
+    return cpus;
+}
+
+struct NumaNode {
+    int id;
+    std::vector<int> cpus; // CPUs of the node that this process is allowed to run on
+};
+
+// CPUs allowed for this process
+inline std::vector<int> getAllowedCpus() {
+    std::vector<int> cpus;
+#if defined(__linux__)
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+        for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+            if (CPU_ISSET(cpu, &set)) {
+                cpus.push_back(cpu);
+            }
+        }
+    }
+#endif
+    if (cpus.empty()) {
+        for (int cpu = 0; cpu < defaultThreadCount(); ++cpu) {
+            cpus.push_back(cpu);
+        }
+    }
+    return cpus;
+}
+
+// NUMA nodes of the machine (from /sys/devices/system/node).
+// If there is no such information, the whole machine is one node with all allowed CPUs.
+inline std::vector<NumaNode> getNumaNodes() {
+    std::vector<int> allowed = getAllowedCpus();
+    std::vector<NumaNode> nodes;
+    std::ifstream online("/sys/devices/system/node/online");
+    std::string onlineList;
+    std::getline(online, onlineList);
+    for (int id : parseCpuList(onlineList)) {
+        std::ifstream file("/sys/devices/system/node/node" + std::to_string(id) + "/cpulist");
+        if (!file) {
+            continue;
+        }
+        std::string list;
+        std::getline(file, list);
+        NumaNode node{id, {}};
+        for (int cpu : parseCpuList(list)) {
+            if (std::find(allowed.begin(), allowed.end(), cpu) != allowed.end()) {
+                node.cpus.push_back(cpu);
+            }
+        }
+        if (!node.cpus.empty()) {
+            nodes.push_back(node);
+        }
+    }
+    if (nodes.empty()) {
+        nodes.push_back(NumaNode{0, allowed});
+    }
+    return nodes;
+}
+
+// Pins calling thread to a single CPU, returns false if it is not possible
+inline bool pinCurrentThreadToCpu(int cpu) {
+#if defined(__linux__)
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#else
+    (void)cpu;
+    return false;
+#endif
+}
+
+// Threads that are started once and then run one task after another.
+// Worker i is pinned to cpus[i] when it starts (-1 leaves it unpinned), so code that runs the same
+// work on the same worker every time keeps its memory on one CPU without calling sched_setaffinity again.
+class WorkerPool {
+public:
+    explicit WorkerPool(const std::vector<int>& cpus) : pinned(cpus.size(), false) {
+        for (std::size_t worker = 0; worker < cpus.size(); ++worker) {
+            threads.emplace_back(&WorkerPool::work, this, static_cast<int>(worker), cpus[worker]);
+        }
+    }
+
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool& operator=(const WorkerPool&) = delete;
+
+    ~WorkerPool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        taskReady.notify_all();
+        for (auto& thread : threads) {
+            thread.join();
+        }
+    }
+
+    int getWorkerCount() const {
+        return static_cast<int>(threads.size());
+    }
+
+    // Runs task(worker) on workers [0, count) and waits until all of them finish.
+    // Calls from several threads at the same time are not supported.
+    void run(int count, const std::function<void(int)>& task) {
+        count = std::min(count, getWorkerCount());
+        if (count <= 0) {
+            return;
+        }
+        std::unique_lock<std::mutex> lock(mutex);
+        currentTask = &task;
+        taskWorkers = count;
+        running = count;
+        taskNumber++;
+        taskReady.notify_all();
+        taskDone.wait(lock, [&] { return running == 0; });
+        currentTask = nullptr;
+    }
+
+    // true if worker was pinned to its CPU; valid after the worker has run a task
+    bool isPinned(int worker) const {
+        return pinned[worker];
+    }
+
+private:
+    void work(int worker, int cpu) {
+        pinned[worker] = cpu >= 0 && pinCurrentThreadToCpu(cpu);
+        std::uint64_t seenTask = 0;
+        std::unique_lock<std::mutex> lock(mutex);
+        while (true) {
+            taskReady.wait(lock, [&] { return stopping || taskNumber != seenTask; });
+            if (stopping) {
+                return;
+            }
+            seenTask = taskNumber;
+            if (worker >= taskWorkers) {
+                continue;
+            }
+            const std::function<void(int)>& task = *currentTask;
+            lock.unlock();
+            task(worker);
+            lock.lock();
+            if (--running == 0) {
+                taskDone.notify_one();
+            }
+        }
+    }
+
+    std::vector<char> pinned; // written by the worker before it takes a task
+    std::vector<std::thread> threads;
+    std::mutex mutex;
+    std::condition_variable taskReady;
+    std::condition_variable taskDone;
+    const std::function<void(int)>* currentTask = nullptr;
+    int taskWorkers = 0;
+    int running = 0;
+    std::uint64_t taskNumber = 0;
+    bool stopping = false;
+};
+
+TEST_CASE("parallelFor splits range into contiguous parts") {
+    std::vector<int> owner(10, -1);
+    parallelFor(0, 10, 3, [&](int worker, int begin, int end) {
+        for (int i = begin; i < end; ++i) {
+            owner[i] = worker;
+        }
+    });
+    CHECK(owner == std::vector<int>{0, 0, 0, 1, 1, 1, 2, 2, 2, 2});
+
+    // more threads than elements
+    std::vector<int> single(2, -1);
+    parallelFor(0, 2, 8, [&](int worker, int begin, int end) {
+        for (int i = begin; i < end; ++i) {
+            single[i] = worker;
+        }
+    });
+    CHECK(single == std::vector<int>{0, 1});
+}
+
+TEST_CASE("worker pool runs tasks on the same threads") {
+    WorkerPool pool({-1, -1, -1});
+    CHECK(pool.getWorkerCount() == 3);
+    std::vector<std::thread::id> firstIds(3);
+    pool.run(3, [&](int worker) { firstIds[worker] = std::this_thread::get_id(); });
+    std::vector<char> sameThread(3, true);
+    std::vector<int> calls(3, 0);
+    for (int task = 0; task < 20; ++task) {
+        pool.run(2, [&](int worker) {
+            calls[worker]++;
+            sameThread[worker] = sameThread[worker] && std::this_thread::get_id() == firstIds[worker];
+        });
+    }
+    CHECK(sameThread == std::vector<char>{true, true, true});
+    CHECK(calls == std::vector<int>{20, 20, 0});
+    CHECK(!pool.isPinned(0));
+    CHECK(firstIds[0] != firstIds[1]);
+}
+
+TEST_CASE("NUMA topology") {
+    CHECK(parseCpuList("0-3,8,10-11\n") == std::vector<int>{0, 1, 2, 3, 8, 10, 11});
+    CHECK(parseCpuList("5") == std::vector<int>{5});
+
+    auto nodes = getNumaNodes();
+    REQUIRE(!nodes.empty());
+    size_t cpuCount = 0;
+    for (const auto& node : nodes) {
+        CHECK(!node.cpus.empty());
+        cpuCount += node.cpus.size();
+    }
+    CHECK(cpuCount == getAllowedCpus().size());
+}
@@ -0,0 +1,168 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+#include "../doctest.h"
+
+#include "cell_buffer.h"
+#include "parallel.h"
+#include "update.h"
+
+// Memory traffic of threads running on one NUMA node during the last update
+struct NodeBandwidth {
+    int node = 0;
+    int threads = 0;
+    std::size_t bytes = 0; // estimated: every cell of the band is read and written once
+    double seconds = 0.0;  // time of the slowest thread of the node
+
+    // estimate from bytes above, not a measured memory traffic
+    double estimatedGigabytesPerSecond() const {
+        return seconds > 0.0 ? bytes / seconds / 1e9 : 0.0;
+    }
+};
+
+struct ParallelUpdateStats {
+    std::vector<NodeBandwidth> nodes;
+    int pinnedThreads = 0; // threads that were successfully pinned to their CPU
+};
+
+// Updates grid using several threads, every thread computes its own band of rows.
+// Threads are spread over NUMA nodes (consecutive bands on the same node), started once and pinned to CPUs
+// when the updater is made, and every generation worker i updates the same band.
+// Pages of new cells are placed on the node of the thread that writes them first (first-touch policy).
+// That puts a band on its thread's node only when GridAllocator did not fill the buffer with zeros,
+// which is for buffers of 2M and more, and only with RowMajorLayout, where a band is one contiguous range.
+// Smaller buffers were already touched by the allocating thread, and bands of other layouts share pages.
+class ParallelUpdater {
+public:
+    explicit ParallelUpdater(int threadCount = defaultThreadCount(), BoundaryMode boundaryMode = BoundaryMode::Dead)
+        : threadCount(std::max(1, threadCount)), updater(boundaryMode) {
+        std::vector<NumaNode> nodes = getNumaNodes();
+        int nodeCount = static_cast<int>(nodes.size());
+        std::vector<int> usedCpusOfNode(nodeCount, 0);
+        std::vector<int> workerCpu;
+        for (int worker = 0; worker < this->threadCount; ++worker) {
+            int nodeIndex = worker * nodeCount / this->threadCount;
+            const NumaNode& node = nodes[nodeIndex];
+            workerNode.push_back(node.id);
+            workerCpu.push_back(node.cpus[usedCpusOfNode[nodeIndex]++ % node.cpus.size()]);
+        }
+        workers = std::make_unique<WorkerPool>(workerCpu);
+    }
+
+    int getThreadCount() const {
+        return threadCount;
+    }
+
+    // Computes next generation of cells into newCells, which should be a new buffer of the same size.
+    // Returns true if any cell changed.
+    template <typename ValueT, typename Layout>
+    bool update(const CellBuffer<ValueT, Layout>& cells, CellBuffer<ValueT, Layout>& newCells) {
+        int rows = cells.getRows();
+        if (rows == 0) {
+            return false;
+        }
+        int bands = std::max(1, std::min(threadCount, rows));
+        std::vector<char> bandChanged(bands, false);
+        std::vector<double> bandSeconds(bands, 0.0);
+        std::vector<std::size_t> bandBytes(bands, 0);
+
+        // same split as parallelFor, so a worker keeps its band
+        workers->run(bands, [&](int worker) {
+            int rowBegin = static_cast<int>(static_cast<long long>(rows) * worker / bands);
+            int rowEnd = static_cast<int>(static_cast<long long>(rows) * (worker + 1) / bands);
+            auto start = std::chrono::steady_clock::now();
+            bandChanged[worker] = updater.updateRows(cells, newCells, rowBegin, rowEnd);
+            std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+            bandSeconds[worker] = elapsed.count();
+            bandBytes[worker] = 2 * cells.memoryBytes() / rows * (rowEnd - rowBegin);
+        });
+
+        lastStats = ParallelUpdateStats();
+        for (int worker = 0; worker < bands; ++worker) {
+            lastStats.pinnedThreads += workers->isPinned(worker);
+            auto node = std::find_if(lastStats.nodes.begin(), lastStats.nodes.end(),
+                [&](const NodeBandwidth& entry) { return entry.node == workerNode[worker]; });
+            if (node == lastStats.nodes.end()) {
+                lastStats.nodes.push_back(NodeBandwidth());
+                node = lastStats.nodes.end() - 1;
+                node->node = workerNode[worker];
+            }
+            node->threads++;
+            node->bytes += bandBytes[worker];
+            node->seconds = std::max(node->seconds, bandSeconds[worker]);
+        }
+
+        return std::find(bandChanged.begin(), bandChanged.end(), true) != bandChanged.end();
+    }
+
+    const ParallelUpdateStats& getLastStats() const {
+        return lastStats;
+    }
+
+private:
+    int threadCount;
+    std::vector<int> workerNode; // NUMA node of every worker
+    std::unique_ptr<WorkerPool> workers; // in a pointer, so the updater can be moved
+    Updater updater;
+    ParallelUpdateStats lastStats;
+};
+
+TEST_CASE("parallel update gives the same result as serial update") {
+    CellBuffer<int> cells(50, 70);
+    CellBuffer<bool> bits(50, 70);
+    for (int r = 0; r < 50; ++r) {
+        for (int c = 0; c < 70; ++c) {
+            bool alive = (r * 7 + c * 13) % 5 < 2;
+            cells.setValue(r, c, alive);
+            bits.setValue(r, c, alive);
+        }
+    }
+
+    Updater serial;
+    ParallelUpdater parallel(4);
+    CHECK(parallel.getThreadCount() == 4);
+    for (int generation = 0; generation < 10; ++generation) {
+        CellBuffer<int> expected = serial.update(cells);
+        CellBuffer<int> newCells(50, 70);
+        CHECK(parallel.update(cells, newCells) == (expected != cells));
+        CHECK(newCells == expected);
+
+        // bands of bit-packed rows are separate words, so threads don't write the same memory
+        CellBuffer<bool> newBits(50, 70);
+        parallel.update(bits, newBits);
+        bool bitsMatch = true;
+        for (int r = 0; r < 50; ++r) {
+            for (int c = 0; c < 70; ++c) {
+                bitsMatch = bitsMatch && newBits.getValue(r, c) == (expected.getValue(r, c) == 1);
+            }
+        }
+        CHECK(bitsMatch);
+
+        cells = std::move(newCells);
+        bits = std::move(newBits);
+    }
+
+    const ParallelUpdateStats& stats = parallel.getLastStats();
+    int threads = 0;
+    std::size_t bytes = 0;
+    for (const auto& node : stats.nodes) {
+        threads += node.threads;
+        bytes += node.bytes;
+    }
+    CHECK(threads == 4);
+    CHECK(bytes > 0);
+}
+
+TEST_CASE("parallel update of grid with fewer rows than threads") {
+    CellBuffer<int> cells(2, 3);
+    cells.setValue(0, 0, 1);
+    CellBuffer<int> newCells(2, 3);
+    ParallelUpdater parallel(8);
+    CHECK(parallel.update(cells, newCells)); // single cell dies
+    CHECK(newCells == CellBuffer<int>(2, 3));
+}
@@ -0,0 +1,152 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+// x with base * x == 1 (mod 2^64) for odd base, by Newton's iteration; every step doubles the number of correct bits
+constexpr std::uint64_t inverseModulo64(std::uint64_t base) {
+    std::uint64_t result = base; // correct in the lowest 3 bits
+    for (int step = 0; step < 5; ++step) {
+        result *= 2 - base * result;
+    }
+    return result;
+}
+
+// Summary of a region that is kept up to date while cells are added,
+// so users of the region don't need another pass over its cells.
+struct RegionDescriptor {
+    // bounding box, bottom < top while the region is empty
+    int top = 0;
+    int left = 0;
+    int bottom = -1;
+    int right = -1;
+    std::size_t cellCount = 0;
+    std::int64_t rowSum = 0;
+    std::int64_t colSum = 0;
+
+    bool empty() const { return cellCount == 0; }
+
+    int getRows() const { return bottom - top + 1; }
+
+    int getCols() const { return right - left + 1; }
+
+    // average position of the cells, undefined for an empty region
+    double getCentroidRow() const { return static_cast<double>(rowSum) / cellCount; }
+
+    double getCentroidCol() const { return static_cast<double>(colSum) / cellCount; }
+
+    // Hash of the cells and their values relative to the bounding box. It is the same for regions
+    // that look the same wherever they are in the grid, whatever order their cells were added in.
+    std::uint64_t getContentHash() const {
+        if (cellCount == 0) {
+            return 0;
+        }
+        // moving the box corner to (0, 0) divides every term by rowBase^top * colBase^left
+        std::uint64_t relative = cellSum * power(rowBase, rowBaseInverse, -top) * power(colBase, colBaseInverse, -left);
+        std::uint64_t size = (static_cast<std::uint64_t>(static_cast<std::uint32_t>(getRows())) << 32)
+                             | static_cast<std::uint32_t>(getCols());
+        return mix(relative ^ mix(size ^ mix(cellCount)));
+    }
+
+    // value is the value of the cell in the grid, 1 for a live cell of a bool grid
+    void addCell(int row, int col, std::int64_t value = 1) {
+        if (cellCount == 0) {
+            top = bottom = row;
+            left = right = col;
+        } else {
+            top = std::min(top, row);
+            bottom = std::max(bottom, row);
+            left = std::min(left, col);
+            right = std::max(right, col);
+        }
+
+        // labelers add cells of a row from left to right, so most cells take one multiplication
+        if (cellCount == 0 || row != lastRow) {
+            rowPower = cellCount != 0 && row == lastRow + 1 ? rowPower * rowBase : power(rowBase, rowBaseInverse, row);
+            colPower = power(colBase, colBaseInverse, col);
+        } else if (col == lastCol + 1) {
+            colPower *= colBase;
+        } else {
+            colPower = power(colBase, colBaseInverse, col);
+        }
+        lastRow = row;
+        lastCol = col;
+        cellSum += mix(static_cast<std::uint64_t>(value)) * rowPower * colPower;
+
+        cellCount++;
+        rowSum += row;
+        colSum += col;
+    }
+
+private:
+    // Every cell adds mix(value) * rowBase^row * colBase^col (mod 2^64). The sum does not depend on the order,
+    // and moving the region multiplies it by one number, which getContentHash() divides out.
+    // Bases are odd, so they have inverses modulo 2^64.
+    static constexpr std::uint64_t rowBase = 0x9e3779b97f4a7c15ULL;
+    static constexpr std::uint64_t colBase = 0xc2b2ae3d27d4eb4fULL;
+
+    static_assert(rowBase * inverseModulo64(rowBase) == 1 && colBase * inverseModulo64(colBase) == 1);
+    static constexpr std::uint64_t rowBaseInverse = inverseModulo64(rowBase);
+    static constexpr std::uint64_t colBaseInverse = inverseModulo64(colBase);
+
+    // base^exponent (mod 2^64), negative exponents use the inverse
+    static std::uint64_t power(std::uint64_t base, std::uint64_t baseInverse, std::int64_t exponent) {
+        if (exponent < 0) {
+            base = baseInverse;
+            exponent = -exponent;
+        }
+        std::uint64_t result = 1;
+        for (; exponent != 0; exponent >>= 1) {
+            if (exponent & 1) {
+                result *= base;
+            }
+            base *= base;
+        }
+        return result;
+    }
+
+    // splitmix64 finalizer: every bit of the result depends on every bit of value
+    static std::uint64_t mix(std::uint64_t value) {
+        value += 0x9e3779b97f4a7c15ULL;
+        value = (value ^ (value >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        value = (value ^ (value >> 27)) * 0x94d049bb133111ebULL;
+        return value ^ (value >> 31);
+    }
+
+    std::uint64_t cellSum = 0;
+    // row and column of the last added cell and their powers
+    int lastRow = 0;
+    int lastCol = 0;
+    std::uint64_t rowPower = 1;
+    std::uint64_t colPower = 1;
+};
+
+// Cells of one connected group of live cells.
+// Labelers of the grid list cells in row-major order, so getCoordinates()[0] is the first cell of the region
+// met by a raster scan; cells added by other code keep the order of the addCell calls.
+// Cells can only be added with addCell, which updates the descriptor, so the descriptor always describes them.
+class Region {
+public:
+    const std::vector<std::pair<int, int>>& getCoordinates() const { return coordinates; }
+
+    const RegionDescriptor& getDescriptor() const { return descriptor; }
+
+    std::size_t size() const { return coordinates.size(); }
+
+    bool empty() const { return coordinates.empty(); }
+
+    void reserve(std::size_t cellCount) { coordinates.reserve(cellCount); }
+
+    // value is the value of the cell in the grid, for the content hash of the descriptor
+    void addCell(int row, int col, std::int64_t value = 1) {
+        coordinates.emplace_back(row, col);
+        descriptor.addCell(row, col, value);
+    }
+
+private:
+    std::vector<std::pair<int, int>> coordinates;
+    RegionDescriptor descriptor;
+};
@@ -0,0 +1,446 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+#include "../doctest.h"
+
+#include "cell_buffer.h"
+#include "parallel.h"
+#include "region.h"
+
+// Disjoint sets of labels 0, 1, 2, ... with path compression.
+// Root of every set is its smallest label, so if labels are given in raster order,
+// roots of sets are in the raster order of their first cells.
+class UnionFind {
+public:
+    // adds new set with a single label and returns this label
+    int add() {
+        int label = static_cast<int>(parent.size());
+        parent.push_back(label);
+        return label;
+    }
+
+    int size() const {
+        return static_cast<int>(parent.size());
+    }
+
+    int find(int label) {
+        while (parent[label] != label) {
+            parent[label] = parent[parent[label]]; // path halving: every visited label skips one level
+            label = parent[label];
+        }
+        return label;
+    }
+
+    // joins sets of both labels and returns root of the joined set
+    int unite(int first, int second) {
+        first = find(first);
+        second = find(second);
+        if (first < second) {
+            parent[second] = first;
+            return first;
+        }
+        parent[first] = second;
+        return second;
+    }
+
+private:
+    std::vector<int> parent;
+};
+
+// Region number of every cell: 0 for dead cells, 1..regionCount for live ones.
+// Regions are numbered in the raster order of their first cells.
+struct RegionLabels {
+    int rows = 0;
+    int cols = 0;
+    int regionCount = 0;
+    std::vector<int> labels; // row-major order
+
+    int getLabel(int row, int col) const {
+        if (row < 0 || row >= rows || col < 0 || col >= cols) {
+            throw std::out_of_range("Cell index out of range");
+        }
+        return labels[static_cast<std::size_t>(row) * cols + col];
+    }
+};
+
+// Finds groups of live (non-zero) cells connected through any of their 8 neighbors.
+// Two raster scans instead of a flood fill:
+// 1. every live cell gets the label of its already scanned neighbors (left, and three above);
+//    when they have different labels, the labels are joined in union-find;
+// 2. every label is replaced by the number of its set.
+// Memory is one label per cell plus one union-find entry per provisional label, nothing is allocated per cell.
+class RegionLabeler {
+public:
+    template <typename ValueT, typename Layout>
+    RegionLabels label(const CellBuffer<ValueT, Layout>& cells) const {
+        RegionLabels result;
+        result.rows = cells.getRows();
+        result.cols = cells.getCols();
+        result.labels.assign(static_cast<std::size_t>(result.rows) * result.cols, 0);
+        int cols = result.cols;
+        std::vector<int>& labels = result.labels;
+
+        UnionFind sets;
+        sets.add(); // label 0 means "no region"
+        for (int r = 0; r < result.rows; ++r) {
+            for (int c = 0; c < cols; ++c) {
+                if (cells.getValue(r, c) == 0) {
+                    continue;
+                }
+                std::size_t index = static_cast<std::size_t>(r) * cols + c;
+                int label = 0;
+                auto join = [&](int neighborLabel) {
+                    if (neighborLabel != 0) {
+                        label = label == 0 ? neighborLabel : sets.unite(label, neighborLabel);
+                    }
+                };
+                if (c > 0) {
+                    join(labels[index - 1]);
+                }
+                if (r > 0) {
+                    std::size_t above = index - cols;
+                    if (c > 0) {
+                        join(labels[above - 1]);
+                    }
+                    join(labels[above]);
+                    if (c + 1 < cols) {
+                        join(labels[above + 1]);
+                    }
+                }
+                labels[index] = label != 0 ? label : sets.add();
+            }
+        }
+
+        result.regionCount = resolve(sets, labels);
+        return result;
+    }
+
+    // Regions of labeled cells; cells of every region are in row-major order.
+    // Values of the cells for the region descriptors are read from cells, which were labeled.
+    template <typename ValueT, typename Layout>
+    static std::vector<Region> toRegions(const RegionLabels& labels, const CellBuffer<ValueT, Layout>& cells) {
+        std::vector<std::size_t> sizes(labels.regionCount + 1, 0);
+        for (int label : labels.labels) {
+            sizes[label]++;
+        }
+        std::vector<Region> regions(labels.regionCount);
+        for (int region = 0; region < labels.regionCount; ++region) {
+            regions[region].reserve(sizes[region + 1]);
+        }
+        for (int r = 0; r < labels.rows; ++r) {
+            for (int c = 0; c < labels.cols; ++c) {
+                int label = labels.labels[static_cast<std::size_t>(r) * labels.cols + c];
+                if (label != 0) {
+                    regions[label - 1].addCell(r, c, static_cast<std::int64_t>(cells.getValue(r, c)));
+                }
+            }
+        }
+        return regions;
+    }
+
+    template <typename ValueT, typename Layout>
+    std::vector<Region> getRegions(const CellBuffer<ValueT, Layout>& cells) const {
+        return toRegions(label(cells), cells);
+    }
+
+private:
+    // Replaces provisional labels by numbers of their sets and returns the number of sets.
+    // Root of a set is its smallest label, so numbers follow the raster order of the first cells.
+    static int resolve(UnionFind& sets, std::vector<int>& labels) {
+        std::vector<int> numbers(sets.size(), 0);
+        int count = 0;
+        for (int label = 1; label < sets.size(); ++label) {
+            int root = sets.find(label);
+            numbers[label] = root == label ? ++count : numbers[root];
+        }
+        for (int& label : labels) {
+            label = numbers[label];
+        }
+        return count;
+    }
+};
+
+// Union-find that several threads can use at once, for labels 0..size-1.
+// Like UnionFind, root of every set is its smallest label. Roots are linked with compare-and-swap,
+// and path halving only replaces a parent with one of its ancestors, so it is safe without locks.
+class ConcurrentUnionFind {
+public:
+    explicit ConcurrentUnionFind(std::size_t size) : parent(size) {
+    }
+
+    // makes label a set of its own; only the thread that owns the label may call it
+    void reset(int label) {
+        parent[label].store(label, std::memory_order_relaxed);
+    }
+
+    int find(int label) {
+        int next = parent[label].load(std::memory_order_relaxed);
+        while (next != label) {
+            int grandparent = parent[next].load(std::memory_order_relaxed);
+            parent[label].store(grandparent, std::memory_order_relaxed);
+            label = next;
+            next = grandparent;
+        }
+        return label;
+    }
+
+    int unite(int first, int second) {
+        while (true) {
+            first = find(first);
+            second = find(second);
+            if (first == second) {
+                return first;
+            }
+            if (first < second) {
+                std::swap(first, second);
+            }
+            // link larger root under smaller one; fails if another thread has linked it meanwhile
+            int expected = first;
+            if (parent[first].compare_exchange_weak(expected, second)) {
+                return second;
+            }
+        }
+    }
+
+    // after all unions are done, the array can be reused to keep a number for every label
+    void set(int label, int value) {
+        parent[label].store(value, std::memory_order_relaxed);
+    }
+
+    int get(int label) const {
+        return parent[label].load(std::memory_order_relaxed);
+    }
+
+private:
+    std::vector<std::atomic<int>> parent;
+};
+
+// Same labels as RegionLabeler, computed by several threads.
+// Grid is split into bands of rows (one band per thread, as in ParallelUpdater), every band is labeled
+// independently, then labels of cells on both sides of every border between bands are joined.
+// Provisional label of a cell is its index + 1, so bands don't need to coordinate when they create labels,
+// and the root of every region is the label of its first cell in raster order.
+// Regions are numbered in that order, so the result does not depend on the number of threads.
+class ParallelRegionLabeler {
+public:
+    explicit ParallelRegionLabeler(int threadCount = defaultThreadCount())
+        : threadCount(std::max(1, threadCount)) {}
+
+    int getThreadCount() const {
+        return threadCount;
+    }
+
+    template <typename ValueT, typename Layout>
+    RegionLabels label(const CellBuffer<ValueT, Layout>& cells) const {
+        int rows = cells.getRows();
+        int cols = cells.getCols();
+        int bands = std::min(threadCount, rows);
+        if (bands <= 1 || cols == 0) {
+            return RegionLabeler().label(cells); // compact labels and a plain union-find are faster for one thread
+        }
+        RegionLabels result;
+        result.rows = rows;
+        result.cols = cols;
+        result.labels.assign(static_cast<std::size_t>(rows) * cols, 0);
+        std::vector<int>& labels = result.labels;
+        ConcurrentUnionFind sets(labels.size() + 1);
+        std::vector<int> bandBegin(bands + 1, rows);
+
+        // every band is labeled on its own, as if there were nothing above it
+        parallelFor(0, rows, threadCount, [&](int band, int rowBegin, int rowEnd) {
+            bandBegin[band] = rowBegin;
+            for (int r = rowBegin; r < rowEnd; ++r) {
+                for (int c = 0; c < cols; ++c) {
+                    if (cells.getValue(r, c) == 0) {
+                        continue;
+                    }
+                    std::size_t index = static_cast<std::size_t>(r) * cols + c;
+                    int label = 0;
+                    auto join = [&](int neighborLabel) {
+                        if (neighborLabel != 0) {
+                            label = label == 0 ? neighborLabel : sets.unite(label, neighborLabel);
+                        }
+                    };
+                    if (c > 0) {
+                        join(labels[index - 1]);
+                    }
+                    if (r > rowBegin) {
+                        std::size_t above = index - cols;
+                        if (c > 0) {
+                            join(labels[above - 1]);
+                        }
+                        join(labels[above]);
+                        if (c + 1 < cols) {
+                            join(labels[above + 1]);
+                        }
+                    }
+                    if (label == 0) {
+                        label = static_cast<int>(index) + 1;
+                        sets.reset(label);
+                    }
+                    labels[index] = label;
+                }
+            }
+        });
+
+        // join regions across borders: first row of every band with the last row of the band above
+        parallelFor(1, bands, threadCount, [&](int, int borderBegin, int borderEnd) {
+            for (int band = borderBegin; band < borderEnd; ++band) {
+                int r = bandBegin[band];
+                for (int c = 0; c < cols; ++c) {
+                    int label = labels[static_cast<std::size_t>(r) * cols + c];
+                    if (label == 0) {
+                        continue;
+                    }
+                    std::size_t above = static_cast<std::size_t>(r - 1) * cols + c;
+                    for (int offset = (c > 0 ? -1 : 0); offset <= (c + 1 < cols ? 1 : 0); ++offset) {
+                        if (labels[above + offset] != 0) {
+                            sets.unite(label, labels[above + offset]);
+                        }
+                    }
+                }
+            }
+        });
+
+        // replace labels by roots and count regions whose first cell is in every band
+        std::vector<int> bandRegions(bands + 1, 0);
+        parallelFor(0, rows, threadCount, [&](int band, int rowBegin, int rowEnd) {
+            for (std::size_t index = static_cast<std::size_t>(rowBegin) * cols;
+                 index < static_cast<std::size_t>(rowEnd) * cols; ++index) {
+                if (labels[index] != 0) {
+                    labels[index] = sets.find(labels[index]);
+                    bandRegions[band + 1] += labels[index] == static_cast<int>(index) + 1;
+                }
+            }
+        });
+        for (int band = 0; band < bands; ++band) {
+            bandRegions[band + 1] += bandRegions[band];
+        }
+        result.regionCount = bandRegions[bands];
+
+        // number regions in raster order of their first cells, numbers are kept in place of roots
+        parallelFor(0, rows, threadCount, [&](int band, int rowBegin, int rowEnd) {
+            int number = bandRegions[band];
+            for (std::size_t index = static_cast<std::size_t>(rowBegin) * cols;
+                 index < static_cast<std::size_t>(rowEnd) * cols; ++index) {
+                if (labels[index] == static_cast<int>(index) + 1) {
+                    sets.set(labels[index], ++number);
+                }
+            }
+        });
+        parallelFor(0, rows, threadCount, [&](int, int rowBegin, int rowEnd) {
+            for (std::size_t index = static_cast<std::size_t>(rowBegin) * cols;
+                 index < static_cast<std::size_t>(rowEnd) * cols; ++index) {
+                if (labels[index] != 0) {
+                    labels[index] = sets.get(labels[index]);
+                }
+            }
+        });
+        return result;
+    }
+
+    template <typename ValueT, typename Layout>
+    std::vector<Region> getRegions(const CellBuffer<ValueT, Layout>& cells) const {
+        return RegionLabeler::toRegions(label(cells), cells);
+    }
+
+private:
+    int threadCount;
+};
+
+TEST_CASE("union-find keeps the smallest label as root") {
+    UnionFind sets;
+    for (int i = 0; i < 6; ++i) {
+        sets.add();
+    }
+    CHECK(sets.unite(4, 2) == 2);
+    CHECK(sets.unite(5, 4) == 2);
+    CHECK(sets.unite(3, 1) == 1);
+    CHECK(sets.find(5) == 2);
+    CHECK(sets.unite(5, 3) == 1);
+    CHECK(sets.find(4) == 1);
+    CHECK(sets.find(0) == 0);
+}
+
+TEST_CASE("region labeling joins cells through diagonal neighbors") {
+    // U-shape joined only at the bottom, and a separate diagonal line
+    CellBuffer<int> cells(4, 6);
+    for (auto [r, c] : {std::pair<int, int>{0, 0}, {1, 0}, {2, 1}, {2, 2}, {1, 3}, {0, 3}, {0, 5}, {1, 5}, {2, 5}, {3, 4}}) {
+        cells.setValue(r, c, 1);
+    }
+    RegionLabels labels = RegionLabeler().label(cells);
+    CHECK(labels.regionCount == 2);
+    CHECK(labels.getLabel(0, 0) == 1);
+    CHECK(labels.getLabel(0, 3) == 1);
+    CHECK(labels.getLabel(0, 5) == 2);
+    CHECK(labels.getLabel(3, 4) == 2);
+    CHECK(labels.getLabel(3, 0) == 0);
+
+    std::vector<Region> regions = RegionLabeler::toRegions(labels, cells);
+    REQUIRE(regions.size() == 2);
+    CHECK(regions[0].getCoordinates() == std::vector<std::pair<int, int>>{{0, 0}, {0, 3}, {1, 0}, {1, 3}, {2, 1}, {2, 2}});
+    CHECK(regions[1].getCoordinates() == std::vector<std::pair<int, int>>{{0, 5}, {1, 5}, {2, 5}, {3, 4}});
+}
+
+TEST_CASE("parallel region labeling gives the same labels for any number of threads") {
+    for (double density : {0.3, 0.5, 0.8}) {
+        CellBuffer<bool> cells(61, 47);
+        std::mt19937 random(static_cast<unsigned>(density * 100));
+        std::bernoulli_distribution alive(density);
+        for (int r = 0; r < 61; ++r) {
+            for (int c = 0; c < 47; ++c) {
+                cells.setValue(r, c, alive(random));
+            }
+        }
+        RegionLabels expected = RegionLabeler().label(cells);
+        for (int threadCount : {1, 2, 3, 8, 100}) {
+            RegionLabels labels = ParallelRegionLabeler(threadCount).label(cells);
+            CHECK(labels.regionCount == expected.regionCount);
+            CHECK(labels.labels == expected.labels);
+        }
+    }
+    CHECK(ParallelRegionLabeler(4).label(CellBuffer<int>(0, 5)).regionCount == 0);
+}
+
+TEST_CASE("labeling fills region descriptors") {
+    // the same L-shape twice at different places, a single cell, and the L-shape with another value in it
+    CellBuffer<int> cells(10, 10);
+    for (auto [r, c] : {std::pair<int, int>{0, 1}, {1, 0}, {1, 1}, {1, 2}, {4, 6}, {5, 5}, {5, 6}, {5, 7}, {7, 0},
+                        {8, 5}, {9, 4}, {9, 5}, {9, 6}}) {
+        cells.setValue(r, c, 1);
+    }
+    cells.setValue(9, 6, 2);
+    std::vector<Region> regions = RegionLabeler().getRegions(cells);
+    REQUIRE(regions.size() == 4);
+    const RegionDescriptor& first = regions[0].getDescriptor();
+    CHECK(first.cellCount == 4);
+    CHECK(first.top == 0);
+    CHECK(first.left == 0);
+    CHECK(first.getRows() == 2);
+    CHECK(first.getCols() == 3);
+    CHECK(first.getCentroidRow() == doctest::Approx(0.75));
+    CHECK(first.getCentroidCol() == doctest::Approx(1.0));
+    CHECK(regions[1].getDescriptor().top == 4);
+    CHECK(regions[1].getDescriptor().left == 5);
+    CHECK(regions[1].getDescriptor().getContentHash() == first.getContentHash());
+    CHECK(regions[2].getDescriptor().getContentHash() != first.getContentHash());
+    CHECK(regions[2].getDescriptor().getRows() == 1);
+    CHECK(regions[3].getDescriptor().getContentHash() != first.getContentHash()); // same shape, other value
+
+    // cells added in another order give the same descriptor
+    Region reversed;
+    for (auto cell = first.cellCount; cell-- > 0;) {
+        auto [row, col] = regions[0].getCoordinates()[cell];
+        reversed.addCell(row, col, cells.getValue(row, col));
+    }
+    CHECK(reversed.getDescriptor().getContentHash() == first.getContentHash());
+    CHECK(reversed.getDescriptor().top == first.top);
+    CHECK(reversed.getDescriptor().right == first.right);
+}
@@ -0,0 +1,366 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "../doctest.h"
+
+#include "grid.h"
+#include "region.h"
+#include "update.h"
+
+enum class RegionEventType {
+    Appeared,  // new region made only of cells born in this generation
+    Vanished,  // all cells of the region died
+    Continued, // region changed but is still one region, with the same id
+    Split,     // region fell apart; regionId is the old id, relatedIds are ids of all parts
+    Merged     // regions joined; regionId is the id of the joined region, relatedIds are ids of the old regions
+};
+
+struct RegionEvent {
+    RegionEventType type;
+    int regionId;
+    std::vector<int> relatedIds;
+};
+
+// Keeps regions of live cells (8-connected, as getNonInteractingRegions) with ids that stay the same
+// from one generation to the next. After grid.update(changes), update(changes) finds the regions again
+// only where cells changed: it takes the regions that lost cells or touch born cells, and labels
+// their live cells and the born cells again by flood fill. Other regions are not visited, so the work
+// is proportional to the size of the changed regions, not the grid.
+// Every old region passes its id to the new region that got most of its cells, other new regions get new ids.
+// Regions that are not mentioned by events did not change.
+class RegionTracker {
+public:
+    template <typename ValueT, typename Layout>
+    explicit RegionTracker(const BasicGrid<ValueT, Layout>& grid)
+        : rows(grid.getRows()), cols(grid.getCols()), ids(static_cast<std::size_t>(rows) * cols, 0), nextId(1) {
+        for (const Region& region : grid.getNonInteractingRegions()) {
+            std::vector<std::size_t>& cells = regions[nextId];
+            cells.reserve(region.size());
+            for (const auto& [row, col] : region.getCoordinates()) {
+                cells.push_back(indexOf(row, col));
+                ids[cells.back()] = nextId;
+            }
+            nextId++;
+        }
+    }
+
+    int getRows() const { return rows; }
+
+    int getCols() const { return cols; }
+
+    std::size_t getRegionCount() const { return regions.size(); }
+
+    // id of the region of a live cell, 0 for a dead cell
+    int getRegionId(int row, int col) const {
+        if (row < 0 || row >= rows || col < 0 || col >= cols) {
+            throw std::out_of_range("Cell index out of range");
+        }
+        return ids[indexOf(row, col)];
+    }
+
+    // ids of all regions, in increasing order
+    std::vector<int> getRegionIds() const {
+        std::vector<int> result;
+        result.reserve(regions.size());
+        for (const auto& entry : regions) {
+            result.push_back(entry.first);
+        }
+        std::sort(result.begin(), result.end());
+        return result;
+    }
+
+    // Cells of the region in row-major order. Tracker keeps no values, so the descriptor
+    // counts every cell as a live cell of a bool grid (value 1).
+    Region getRegion(int id) const {
+        return makeRegion(id, [](int, int) { return std::int64_t{1}; });
+    }
+
+    // same, with values of the cells taken from the grid that the tracker follows
+    template <typename ValueT, typename Layout>
+    Region getRegion(int id, const BasicGrid<ValueT, Layout>& grid) const {
+        return makeRegion(id, [&](int row, int col) { return static_cast<std::int64_t>(grid.getCellValue(row, col)); });
+    }
+
+    // Follows the changes reported by grid.update(changes) and returns what happened to regions
+    template <typename ValueT>
+    std::vector<RegionEvent> update(const std::vector<CellChange<ValueT>>& changes) {
+        // cells to label again: born cells (marked bornCell) and live cells of regions that lost cells or touch born cells
+        std::vector<int> touched;
+        std::vector<std::size_t> seeds;
+        for (const auto& change : changes) {
+            std::size_t cell = indexOf(change.row, change.col);
+            if (change.value == 0 && ids[cell] > 0) {
+                touched.push_back(ids[cell]);
+                ids[cell] = 0;
+            } else if (change.value != 0 && ids[cell] == 0) {
+                ids[cell] = bornCell;
+                seeds.push_back(cell);
+            }
+        }
+        for (std::size_t born : seeds) {
+            forEachNeighbor(born, [&](std::size_t neighbor) {
+                if (ids[neighbor] > 0) {
+                    touched.push_back(ids[neighbor]);
+                }
+            });
+        }
+        std::sort(touched.begin(), touched.end());
+        touched.erase(std::unique(touched.begin(), touched.end()), touched.end());
+        for (int id : touched) {
+            for (std::size_t cell : regions[id]) {
+                if (ids[cell] == id) {
+                    seeds.push_back(cell);
+                }
+            }
+        }
+
+        // new regions; ids of their cells still tell which old region the cells were in
+        std::vector<std::vector<std::size_t>> parts;
+        std::vector<std::size_t> stack;
+        for (std::size_t seed : seeds) {
+            if (ids[seed] == visitedCell || ids[seed] == 0) {
+                continue;
+            }
+            parts.emplace_back();
+            std::vector<std::size_t>& part = parts.back();
+            part.push_back(seed);
+            stack.push_back(seed);
+            int oldId = ids[seed];
+            ids[seed] = visitedCell;
+            sources.emplace_back();
+            addSource(oldId);
+            while (!stack.empty()) {
+                std::size_t cell = stack.back();
+                stack.pop_back();
+                forEachNeighbor(cell, [&](std::size_t neighbor) {
+                    if (ids[neighbor] != 0 && ids[neighbor] != visitedCell) {
+                        addSource(ids[neighbor]);
+                        ids[neighbor] = visitedCell;
+                        part.push_back(neighbor);
+                        stack.push_back(neighbor);
+                    }
+                });
+            }
+        }
+
+        std::vector<RegionEvent> events = assignIds(touched, parts);
+        for (int id : touched) {
+            regions.erase(id);
+        }
+        for (std::size_t i = 0; i < parts.size(); ++i) {
+            for (std::size_t cell : parts[i]) {
+                ids[cell] = partIds[i];
+            }
+            regions[partIds[i]] = std::move(parts[i]);
+        }
+        sources.clear();
+        partIds.clear();
+        return events;
+    }
+
+private:
+    // region of id with value(row, col) for every cell
+    template <typename ValueFunction>
+    Region makeRegion(int id, ValueFunction value) const {
+        auto found = regions.find(id);
+        if (found == regions.end()) {
+            throw std::invalid_argument("Unknown region id");
+        }
+        std::vector<std::size_t> cells = found->second;
+        std::sort(cells.begin(), cells.end());
+        Region region;
+        region.reserve(cells.size());
+        for (std::size_t cell : cells) {
+            int row = static_cast<int>(cell / cols);
+            int col = static_cast<int>(cell % cols);
+            region.addCell(row, col, value(row, col));
+        }
+        return region;
+    }
+
+    static constexpr int bornCell = -1;
+    static constexpr int visitedCell = -2;
+
+    std::size_t indexOf(int row, int col) const {
+        return static_cast<std::size_t>(row) * cols + col;
+    }
+
+    template <typename Visitor>
+    void forEachNeighbor(std::size_t cell, Visitor&& visit) const {
+        int row = static_cast<int>(cell / cols);
+        int col = static_cast<int>(cell % cols);
+        for (int r = std::max(0, row - 1); r <= std::min(rows - 1, row + 1); ++r) {
+            for (int c = std::max(0, col - 1); c <= std::min(cols - 1, col + 1); ++c) {
+                if (r != row || c != col) {
+                    visit(indexOf(r, c));
+                }
+            }
+        }
+    }
+
+    // counts one more cell of the last part that was in the old region (or was born)
+    void addSource(int oldId) {
+        if (oldId == bornCell) {
+            return;
+        }
+        auto& partSources = sources.back();
+        for (auto& [id, count] : partSources) {
+            if (id == oldId) {
+                count++;
+                return;
+            }
+        }
+        partSources.emplace_back(oldId, 1);
+    }
+
+    // every old region gives its id to the part with most of its cells; a part that gets several ids keeps
+    // the one it got most cells from
+    std::vector<RegionEvent> assignIds(const std::vector<int>& touched, const std::vector<std::vector<std::size_t>>& parts) {
+        std::unordered_map<int, std::pair<std::size_t, int>> heirs; // old id -> (part, cells from old region)
+        std::unordered_map<int, std::vector<int>> targets;          // old id -> parts
+        for (std::size_t part = 0; part < parts.size(); ++part) {
+            for (const auto& [id, count] : sources[part]) {
+                targets[id].push_back(static_cast<int>(part));
+                auto found = heirs.find(id);
+                if (found == heirs.end() || found->second.second < count) {
+                    heirs[id] = {part, count};
+                }
+            }
+        }
+        partIds.assign(parts.size(), 0);
+        std::vector<int> inheritedCount(parts.size(), 0);
+        for (int id : touched) {
+            auto found = heirs.find(id);
+            if (found == heirs.end()) {
+                continue;
+            }
+            auto [part, count] = found->second;
+            if (count > inheritedCount[part]) {
+                partIds[part] = id;
+                inheritedCount[part] = count;
+            }
+        }
+        for (int& id : partIds) {
+            if (id == 0) {
+                id = nextId++;
+            }
+        }
+
+        std::vector<RegionEvent> events;
+        for (std::size_t part = 0; part < parts.size(); ++part) {
+            if (sources[part].empty()) {
+                events.push_back(RegionEvent{RegionEventType::Appeared, partIds[part], {}});
+            } else if (sources[part].size() > 1) {
+                std::vector<int> merged;
+                for (const auto& source : sources[part]) {
+                    merged.push_back(source.first);
+                }
+                std::sort(merged.begin(), merged.end());
+                events.push_back(RegionEvent{RegionEventType::Merged, partIds[part], merged});
+            }
+        }
+        for (int id : touched) {
+            auto found = targets.find(id);
+            if (found == targets.end()) {
+                events.push_back(RegionEvent{RegionEventType::Vanished, id, {}});
+            } else if (found->second.size() > 1) {
+                std::vector<int> split;
+                for (int part : found->second) {
+                    split.push_back(partIds[part]);
+                }
+                std::sort(split.begin(), split.end());
+                events.push_back(RegionEvent{RegionEventType::Split, id, split});
+            } else if (sources[found->second.front()].size() == 1) {
+                events.push_back(RegionEvent{RegionEventType::Continued, id, {}});
+            }
+        }
+        return events;
+    }
+
+    int rows;
+    int cols;
+    std::vector<int> ids; // region id of every cell in row-major order, 0 for dead cells
+    std::unordered_map<int, std::vector<std::size_t>> regions; // id -> cell indexes, in no particular order
+    int nextId;
+    // used during update(): old regions every new part has cells from (id, cell count), and ids of parts
+    std::vector<std::vector<std::pair<int, int>>> sources;
+    std::vector<int> partIds;
+};
+
+TEST_CASE("RegionTracker keeps ids and reports events") {
+    // blinker far from a block: blinker continues, block is not touched
+    Grid grid(10, 12);
+    for (int c = 1; c <= 3; ++c) {
+        grid.setCellValue(2, c, 1);
+    }
+    for (auto [r, c] : {std::pair<int, int>{7, 8}, {7, 9}, {8, 8}, {8, 9}}) {
+        grid.setCellValue(r, c, 1);
+    }
+    RegionTracker tracker(grid);
+    CHECK(tracker.getRegionCount() == 2);
+    int blinker = tracker.getRegionId(2, 1);
+    int block = tracker.getRegionId(7, 8);
+    CHECK(blinker != block);
+
+    std::vector<CellChange<int>> changes;
+    grid.update(changes);
+    std::vector<RegionEvent> events = tracker.update(changes);
+    REQUIRE(events.size() == 1);
+    CHECK(events[0].type == RegionEventType::Continued);
+    CHECK(events[0].regionId == blinker);
+    CHECK(tracker.getRegionId(1, 2) == blinker);
+    CHECK(tracker.getRegionId(2, 1) == 0);
+    CHECK(tracker.getRegion(blinker).getCoordinates() == std::vector<std::pair<int, int>>{{1, 2}, {2, 2}, {3, 2}});
+
+    // a cell born between blinker and block joins them
+    std::vector<CellChange<int>> bridge{{4, 3, 1}, {5, 4, 1}, {6, 5, 1}, {6, 6, 1}, {7, 7, 1}};
+    events = tracker.update(bridge);
+    REQUIRE(events.size() == 1);
+    CHECK(events[0].type == RegionEventType::Merged);
+    CHECK(events[0].relatedIds == std::vector<int>{std::min(blinker, block), std::max(blinker, block)});
+    CHECK(tracker.getRegionCount() == 1);
+    CHECK(events[0].regionId == block); // block gives more cells than blinker
+
+    // removing the bridge splits them again, block keeps its id
+    std::vector<CellChange<int>> cut{{5, 4, 0}};
+    events = tracker.update(cut);
+    REQUIRE(events.size() == 1);
+    CHECK(events[0].type == RegionEventType::Split);
+    CHECK(events[0].relatedIds.size() == 2);
+    CHECK(tracker.getRegionId(8, 9) == block);
+    CHECK(tracker.getRegionId(1, 2) != block);
+
+    std::vector<CellChange<int>> clear{{1, 2, 0}, {2, 2, 0}, {3, 2, 0}, {4, 3, 0}, {0, 11, 1}};
+    events = tracker.update(clear);
+    REQUIRE(events.size() == 2);
+    CHECK(events[0].type == RegionEventType::Appeared);
+    CHECK(events[1].type == RegionEventType::Vanished);
+}
+
+TEST_CASE("RegionTracker regions match labeling of every generation") {
+    Grid grid(30, 40);
+    grid.fillGridWithRandomValues({0, 1}, {0.65, 0.35});
+    RegionTracker tracker(grid);
+    std::vector<CellChange<int>> changes;
+    bool regionsMatch = true;
+    for (int generation = 0; generation < 20; ++generation) {
+        grid.update(changes);
+        tracker.update(changes);
+        std::vector<Region> expected = grid.getNonInteractingRegions();
+        regionsMatch = regionsMatch && tracker.getRegionCount() == expected.size();
+        for (const Region& region : expected) {
+            int id = tracker.getRegionId(region.getCoordinates()[0].first, region.getCoordinates()[0].second);
+            regionsMatch = regionsMatch && id > 0 && tracker.getRegion(id).getCoordinates() == region.getCoordinates()
+                           && tracker.getRegion(id, grid).getDescriptor().getContentHash()
+                                  == region.getDescriptor().getContentHash();
+        }
+    }
+    CHECK(regionsMatch);
+}
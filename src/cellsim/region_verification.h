@@ -0,0 +1,230 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <stdexcept>
+#include <vector>
+
+#include "../doctest.h"
+
+#include "cell_buffer.h"
+#include "grid.h"
+#include "parallel.h"
+#include "parallel_update.h"
+#include "region.h"
+
+// One region evolved on its own
+template <typename ValueT, typename Layout>
+struct RegionEvolution {
+    int top = 0;  // position of the grid below in the full grid
+    int left = 0;
+    // region's bounding box with generations cells added on every side (cut at the grid border), after evolution
+    BasicGrid<ValueT, Layout> grid;
+    int firstMismatch = -1; // first generation that differs from the full grid, -1 if none
+
+    bool isIsolated() const { return firstMismatch < 0; }
+};
+
+// Evolves every region of a grid on its own, on several threads, and checks that together they give
+// the same cells as the whole grid evolved for the same number of generations.
+// Region is placed in its bounding box with `generations` cells added on every side, so a box of
+// rows x cols cells becomes (rows + 2 * generations) x (cols + 2 * generations), less where it is cut
+// at the grid border. A region grows at most one cell per generation in every direction, so it has room.
+// Every generation all region grids are updated in parallel, their live cells are put together
+// into one grid, and every region compares its box with the whole grid. A cell is wrong when the whole grid
+// has a value there that the regions don't give, or when two regions make it live. A region differs when
+// a wrong cell is next to one of its live cells, in this or the previous generation (those are the cells
+// that decided the new value). So regions that really interact are reported, while regions that are near
+// but never meet are not.
+// Cells outside the grid are dead (BoundaryMode::Dead), the same for the whole grid and the regions.
+template <typename ValueT, typename Layout>
+class RegionVerifier {
+public:
+    explicit RegionVerifier(int generations, int threadCount = defaultThreadCount())
+        : generations(generations), threadCount(std::max(1, threadCount)) {
+        if (generations < 0) {
+            throw std::invalid_argument("Number of generations must not be negative");
+        }
+    }
+
+    int getGenerations() const { return generations; }
+
+    int getThreadCount() const { return threadCount; }
+
+    // results in the order of regions; regions are expected to be the regions of the grid, as getNonInteractingRegions gives them
+    std::vector<RegionEvolution<ValueT, Layout>> verify(const BasicGrid<ValueT, Layout>& grid,
+                                                        const std::vector<Region>& regions) const {
+        int rows = grid.getRows();
+        int cols = grid.getCols();
+        std::vector<RegionEvolution<ValueT, Layout>> results;
+        results.reserve(regions.size());
+        for (const Region& region : regions) {
+            results.push_back(makeEvolution(grid, region));
+        }
+        int regionCount = static_cast<int>(results.size());
+
+        BasicGrid<ValueT, Layout> full = grid;
+        ParallelUpdater fullUpdater(threadCount);
+        CellBuffer<ValueT, Layout> combined(rows, cols);
+        std::vector<unsigned char> liveCount(static_cast<std::size_t>(rows) * cols, 0); // regions that make cell live
+        std::vector<CellBuffer<ValueT, Layout>> previous(regionCount);
+        for (int generation = 1; generation <= generations; ++generation) {
+            full.update(fullUpdater);
+            parallelFor(0, regionCount, threadCount, [&](int, int begin, int end) {
+                for (int i = begin; i < end; ++i) {
+                    previous[i] = results[i].grid.getCells();
+                    results[i].grid.update();
+                }
+            });
+
+            // Region boxes overlap, so every thread puts together the rows of its own band of the grid
+            // from all boxes. Bands don't share cells, so there is nothing to reduce afterwards.
+            parallelFor(0, rows, threadCount, [&](int, int rowBegin, int rowEnd) {
+                forEachBoxCell(results, rowBegin, rowEnd, [&](int row, int col, ValueT) {
+                    combined.setValue(row, col, ValueT{});
+                    liveCount[static_cast<std::size_t>(row) * cols + col] = 0;
+                });
+                forEachBoxCell(results, rowBegin, rowEnd, [&](int row, int col, ValueT value) {
+                    if (value != ValueT{}) {
+                        combined.setValue(row, col, value);
+                        unsigned char& count = liveCount[static_cast<std::size_t>(row) * cols + col];
+                        count = std::min(2, count + 1);
+                    }
+                });
+            });
+
+            parallelFor(0, regionCount, threadCount, [&](int, int begin, int end) {
+                for (int i = begin; i < end; ++i) {
+                    RegionEvolution<ValueT, Layout>& result = results[i];
+                    if (!result.isIsolated()) {
+                        continue;
+                    }
+                    const CellBuffer<ValueT, Layout>& current = result.grid.getCells();
+                    bool matches = true;
+                    for (int r = 0; r < current.getRows() && matches; ++r) {
+                        for (int c = 0; c < current.getCols() && matches; ++c) {
+                            std::size_t cell = static_cast<std::size_t>(result.top + r) * cols + result.left + c;
+                            bool wrong = liveCount[cell] >= 2
+                                         || full.getCells().getValue(result.top + r, result.left + c)
+                                                != combined.getValue(result.top + r, result.left + c);
+                            matches = !wrong || (!hasLiveNeighbor(current, r, c) && !hasLiveNeighbor(previous[i], r, c));
+                        }
+                    }
+                    if (!matches) {
+                        result.firstMismatch = generation;
+                    }
+                }
+            });
+        }
+        return results;
+    }
+
+private:
+    RegionEvolution<ValueT, Layout> makeEvolution(const BasicGrid<ValueT, Layout>& grid, const Region& region) const {
+        RegionEvolution<ValueT, Layout> result{0, 0, BasicGrid<ValueT, Layout>(0, 0), -1};
+        if (region.empty()) {
+            return result;
+        }
+        const RegionDescriptor& box = region.getDescriptor();
+        if (!grid.isValidCoordinates(box.top, box.left) || !grid.isValidCoordinates(box.bottom, box.right)) {
+            throw std::out_of_range("Cell index out of range");
+        }
+        result.top = std::max(0, box.top - generations);
+        result.left = std::max(0, box.left - generations);
+        int bottom = std::min(grid.getRows() - 1, box.bottom + generations);
+        int right = std::min(grid.getCols() - 1, box.right + generations);
+        result.grid = BasicGrid<ValueT, Layout>(bottom - result.top + 1, right - result.left + 1);
+        for (const auto& [row, col] : region.getCoordinates()) {
+            result.grid.setCellValue(row - result.top, col - result.left, grid.getCellValue(row, col));
+        }
+        return result;
+    }
+
+    // true if the cell or one of its 8 neighbors is live
+    static bool hasLiveNeighbor(const CellBuffer<ValueT, Layout>& cells, int row, int col) {
+        for (int r = std::max(0, row - 1); r <= std::min(cells.getRows() - 1, row + 1); ++r) {
+            for (int c = std::max(0, col - 1); c <= std::min(cells.getCols() - 1, col + 1); ++c) {
+                if (cells.getValue(r, c) != ValueT{}) {
+                    return true;
+                }
+            }
+        }
+        return false;
+    }
+
+    // visit(row, col, value) for every cell of every region box that is in rows [rowBegin, rowEnd)
+    // of the full grid, with position in the full grid
+    template <typename Visitor>
+    static void forEachBoxCell(const std::vector<RegionEvolution<ValueT, Layout>>& results, int rowBegin, int rowEnd,
+                               Visitor&& visit) {
+        for (const auto& result : results) {
+            const CellBuffer<ValueT, Layout>& cells = result.grid.getCells();
+            int first = std::max(0, rowBegin - result.top);
+            int last = std::min(cells.getRows(), rowEnd - result.top);
+            for (int r = first; r < last; ++r) {
+                for (int c = 0; c < cells.getCols(); ++c) {
+                    visit(result.top + r, result.left + c, cells.getValue(r, c));
+                }
+            }
+        }
+    }
+
+    int generations;
+    int threadCount;
+};
+
+// regions of the grid evolved on their own for a number of generations and checked against the whole grid
+template <typename ValueT, typename Layout>
+std::vector<RegionEvolution<ValueT, Layout>> verifyRegions(const BasicGrid<ValueT, Layout>& grid,
+                                                            const std::vector<Region>& regions, int generations,
+                                                            int threadCount = defaultThreadCount()) {
+    return RegionVerifier<ValueT, Layout>(generations, threadCount).verify(grid, regions);
+}
+
+TEST_CASE("isolated regions evolve like the whole grid") {
+    // blinker and block far apart, and two blocks close to each other that never meet
+    Grid grid(12, 20);
+    for (int c = 1; c <= 3; ++c) {
+        grid.setCellValue(2, c, 1);
+    }
+    for (auto [r, c] : {std::pair<int, int>{8, 2}, {8, 3}, {9, 2}, {9, 3}, {8, 12}, {8, 13}, {9, 12}, {9, 13},
+                        {8, 15}, {8, 16}, {9, 15}, {9, 16}}) {
+        grid.setCellValue(r, c, 1);
+    }
+    std::vector<Region> regions = grid.getNonInteractingRegions();
+    REQUIRE(regions.size() == 4);
+    for (int threadCount : {1, 3}) {
+        auto results = verifyRegions(grid, regions, 4, threadCount);
+        REQUIRE(results.size() == 4);
+        bool allIsolated = true;
+        for (const auto& result : results) {
+            allIsolated = allIsolated && result.isIsolated();
+        }
+        CHECK(allIsolated);
+        // blinker: box of 1 x 3 cells grown by 4, cut at the top and left border
+        CHECK(results[0].top == 0);
+        CHECK(results[0].left == 0);
+        CHECK(results[0].grid.getRows() == 7);
+        CHECK(results[0].grid.getCols() == 8);
+        CHECK(results[0].grid.getCellValue(2, 1) == 1); // even number of generations, horizontal again
+    }
+}
+
+TEST_CASE("interacting regions are reported") {
+    // two blinkers with one dead column between them are separate regions but interact
+    Grid grid(9, 9);
+    for (int r = 3; r <= 5; ++r) {
+        grid.setCellValue(r, 3, 1);
+        grid.setCellValue(r, 5, 1);
+    }
+    grid.setCellValue(0, 8, 1); // dies alone after one generation
+    std::vector<Region> regions = grid.getNonInteractingRegions();
+    REQUIRE(regions.size() == 3);
+    auto results = verifyRegions(grid, regions, 3, 2);
+    CHECK(results[0].isIsolated());
+    CHECK(results[1].firstMismatch == 1);
+    CHECK(results[2].firstMismatch == 1);
+
+    CHECK(verifyRegions(grid, regions, 0).front().isIsolated());
+    CHECK_THROWS_AS((RegionVerifier<int, RowMajorLayout>(-1)), std::invalid_argument);
+}
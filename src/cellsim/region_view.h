@@ -0,0 +1,222 @@
+#pragma once
+
+#include <algorithm>
+#include <charconv>
+#include <cstdint>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "../doctest.h"
+
+#include "cell.h"
+#include "grid.h"
+#include "region.h"
+
+// Read-only view of one region of a grid: the region's bounding box, where cells of the region
+// have their values from the grid and all other cells are 0. It looks like the grid made by
+// convertRegionToGrid, but refers to the grid and the region instead of copying them,
+// so hashing, writing and printing a region don't allocate. toGrid() makes a real grid when it has to be updated.
+// Grid and region must stay alive and unchanged while the view is used.
+// Cells of regions from the labelers are in row-major order and are used as they are;
+// cells in any other order are copied and sorted once when the view is made.
+template <typename ValueT, typename Layout>
+class RegionView {
+public:
+    // Cells of the region must be inside the grid
+    RegionView(const BasicGrid<ValueT, Layout>& grid, const Region& region)
+        : grid(&grid), region(&region), top(0), left(0), rows(0), cols(0) {
+        const auto& coordinates = region.getCoordinates();
+        if (!std::is_sorted(coordinates.begin(), coordinates.end())) {
+            sortedCells = coordinates;
+            std::sort(sortedCells.begin(), sortedCells.end());
+        }
+        if (coordinates.empty()) {
+            return;
+        }
+        const RegionDescriptor& box = region.getDescriptor();
+        if (!grid.isValidCoordinates(box.top, box.left) || !grid.isValidCoordinates(box.bottom, box.right)) {
+            throw std::out_of_range("Cell index out of range");
+        }
+        top = box.top;
+        left = box.left;
+        rows = box.getRows();
+        cols = box.getCols();
+    }
+
+    // view must not outlive the grid and the region
+    RegionView(BasicGrid<ValueT, Layout>&&, const Region&) = delete;
+    RegionView(const BasicGrid<ValueT, Layout>&, Region&&) = delete;
+
+    int getRows() const { return rows; }
+
+    int getCols() const { return cols; }
+
+    // position of the view in the grid
+    int getTop() const { return top; }
+
+    int getLeft() const { return left; }
+
+    bool contains(int row, int col) const {
+        if (row < 0 || row >= rows || col < 0 || col >= cols) {
+            return false;
+        }
+        const auto& cells = getSortedCells();
+        return std::binary_search(cells.begin(), cells.end(), std::make_pair(top + row, left + col));
+    }
+
+    ValueT getCellValue(int row, int col) const {
+        if (row < 0 || row >= rows || col < 0 || col >= cols) {
+            throw std::out_of_range("Cell index out of range");
+        }
+        return contains(row, col) ? grid->getCellValue(top + row, left + col) : ValueT{};
+    }
+
+    // Calls visit(row, col, value) for every cell of the view in row-major order.
+    // Region cells are met in the same order, so it takes one pass over the box and the region.
+    template <typename Visitor>
+    void forEachCell(Visitor&& visit) const {
+        const CellBuffer<ValueT, Layout>& cells = grid->getCells();
+        auto member = getSortedCells().begin();
+        auto end = getSortedCells().end();
+        for (int r = 0; r < rows; ++r) {
+            for (int c = 0; c < cols; ++c) {
+                std::pair<int, int> cell{top + r, left + c};
+                if (member != end && *member == cell) {
+                    while (member != end && *member == cell) {
+                        ++member; // repeated cells are the same cell
+                    }
+                    visit(r, c, cells.getValue(cell.first, cell.second));
+                } else {
+                    visit(r, c, ValueT{});
+                }
+            }
+        }
+    }
+
+    // Hash of the size and values, equal for views that look the same wherever their regions are
+    std::uint64_t hash() const {
+        std::uint64_t result = 14695981039346656037ULL; // FNV-1a
+        auto add = [&](std::uint64_t value) {
+            result ^= value;
+            result *= 1099511628211ULL;
+        };
+        add(static_cast<std::uint64_t>(rows));
+        add(static_cast<std::uint64_t>(cols));
+        forEachCell([&](int, int, ValueT value) {
+            add(static_cast<std::uint64_t>(toPrintableValue(value)));
+        });
+        return result;
+    }
+
+    // appends the same text as BasicGrid::gridToString of the region grid
+    void appendTo(std::string& out) const {
+        char number[16];
+        forEachCell([&](int, int c, ValueT value) {
+            char* numberEnd = std::to_chars(number, number + sizeof(number), toPrintableValue(value)).ptr;
+            out.append(number, numberEnd);
+            out += ' ';
+            if (c == cols - 1) {
+                out += '\n';
+            }
+        });
+    }
+
+    std::string toString() const {
+        std::string result;
+        appendTo(result);
+        return result;
+    }
+
+    // prints the same as BasicGrid::printGrid of the region grid
+    void print(std::ostream& out = std::cout) const {
+        forEachCell([&](int, int c, ValueT value) {
+            out << toPrintableValue(value) << " ";
+            if (c == cols - 1) {
+                out << std::endl;
+            }
+        });
+    }
+
+    // grid with the cells of the view, for updating it
+    BasicGrid<ValueT, Layout> toGrid() const {
+        BasicGrid<ValueT, Layout> result(rows, cols);
+        for (const auto& [row, col] : region->getCoordinates()) {
+            result.setCellValue(row - top, col - left, grid->getCellValue(row, col));
+        }
+        return result;
+    }
+
+private:
+    // cells of the region in row-major order
+    const std::vector<std::pair<int, int>>& getSortedCells() const {
+        return sortedCells.empty() ? region->getCoordinates() : sortedCells;
+    }
+
+    const BasicGrid<ValueT, Layout>* grid;
+    const Region* region;
+    std::vector<std::pair<int, int>> sortedCells; // sorted copy of the cells, empty if they are already sorted
+    int top;
+    int left;
+    int rows;
+    int cols;
+};
+
+TEST_CASE("RegionView looks like the region grid") {
+    Grid grid(12, 15);
+    grid.fillGridWithRandomValues({0, 1, 2}, {0.5, 0.25, 0.25});
+    std::vector<Region> regions = grid.getNonInteractingRegions();
+    REQUIRE(!regions.empty());
+    bool viewsMatch = true;
+    for (const Region& region : regions) {
+        RegionView view(grid, region);
+        Grid regionGrid = convertRegionToGrid(grid, region);
+        viewsMatch = viewsMatch && view.getRows() == regionGrid.getRows() && view.getCols() == regionGrid.getCols()
+                     && view.toString() == regionGrid.gridToString()
+                     && view.toGrid().gridToString() == regionGrid.gridToString();
+        for (int r = 0; r < view.getRows(); ++r) {
+            for (int c = 0; c < view.getCols(); ++c) {
+                viewsMatch = viewsMatch && view.getCellValue(r, c) == regionGrid.getCellValue(r, c);
+            }
+        }
+    }
+    CHECK(viewsMatch);
+}
+
+TEST_CASE("RegionView hash does not depend on position") {
+    Grid grid(10, 10);
+    for (auto [r, c] : {std::pair<int, int>{1, 1}, {1, 2}, {2, 1}, {6, 6}, {6, 7}, {7, 6}, {8, 1}, {8, 2}, {8, 3}}) {
+        grid.setCellValue(r, c, 1);
+    }
+    std::vector<Region> regions = grid.getNonInteractingRegions();
+    REQUIRE(regions.size() == 3);
+    RegionView first(grid, regions[0]);
+    RegionView second(grid, regions[1]);
+    RegionView line(grid, regions[2]);
+    CHECK(first.getTop() == 1);
+    CHECK(second.getLeft() == 6);
+    CHECK(first.hash() == second.hash());
+    CHECK(first.hash() != line.hash());
+    CHECK(line.toString() == "1 1 1 \n");
+    CHECK(!first.contains(1, 1));
+    CHECK_THROWS_AS(first.getCellValue(2, 0), std::out_of_range);
+
+    // cells in any order give the same view
+    Region unordered;
+    for (auto it = regions[0].getCoordinates().rbegin(); it != regions[0].getCoordinates().rend(); ++it) {
+        unordered.addCell(it->first, it->second);
+    }
+    RegionView reversed(grid, unordered);
+    CHECK(reversed.toString() == first.toString());
+    CHECK(reversed.hash() == first.hash());
+    CHECK(reversed.contains(0, 0));
+    RegionView copied = reversed;
+    CHECK(copied.toString() == first.toString());
+
+    Region noCells;
+    RegionView empty(grid, noCells);
+    CHECK(empty.getRows() == 0);
+    CHECK(empty.toString().empty());
+}
@@ -0,0 +1,196 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+#include "../doctest.h"
+
+#include "cell_buffer.h"
+#include "region.h"
+#include "region_labeling.h"
+
+// number of the lowest set bit of a non-zero word
+inline int countTrailingZeros(std::uint64_t word) {
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_ctzll(word);
+#else
+    int count = 0;
+    while ((word & 1) == 0) {
+        word >>= 1;
+        count++;
+    }
+    return count;
+#endif
+}
+
+// Horizontal run of live cells [colBegin, colEnd) in one row
+struct CellRun {
+    int row;
+    int colBegin;
+    int colEnd;
+    int label; // region number, from 1
+
+    int size() const { return colEnd - colBegin; }
+};
+
+// Regions of a grid described by runs of live cells instead of single cells
+struct RunRegions {
+    int rows = 0;
+    int cols = 0;
+    int regionCount = 0;
+    std::vector<CellRun> runs; // raster order
+
+    // the same regions as RegionLabeler gives: ordered by first cell, cells of every region in row-major order
+    std::vector<Region> toRegions() const {
+        std::vector<std::size_t> sizes(regionCount, 0);
+        for (const CellRun& run : runs) {
+            sizes[run.label - 1] += run.size();
+        }
+        std::vector<Region> regions(regionCount);
+        for (int region = 0; region < regionCount; ++region) {
+            regions[region].reserve(sizes[region]);
+        }
+        for (const CellRun& run : runs) {
+            for (int c = run.colBegin; c < run.colEnd; ++c) {
+                regions[run.label - 1].addCell(run.row, c);
+            }
+        }
+        return regions;
+    }
+};
+
+// Region labeling of bit-packed grids that works with runs of live cells instead of cells.
+// Runs of a row are found a word (64 cells) at a time with count-trailing-zeros, then every run
+// is joined in union-find with the runs of the previous row that touch it, including diagonally.
+// Both rows are sorted by column, so this is a single merge-like pass.
+// Work is proportional to the number of runs (plus the number of words of the grid), not the number of cells.
+class RunLengthLabeler {
+public:
+    RunRegions label(const CellBuffer<bool>& cells) const {
+        RunRegions result;
+        result.rows = cells.getRows();
+        result.cols = cells.getCols();
+
+        UnionFind sets;
+        sets.add(); // label 0 is not used, run i has label i + 1
+        std::size_t previousBegin = 0;
+        for (int r = 0; r < result.rows; ++r) {
+            std::size_t previousEnd = result.runs.size();
+            findRuns(cells, r, result.runs);
+
+            std::size_t previous = previousBegin;
+            for (std::size_t current = previousEnd; current < result.runs.size(); ++current) {
+                CellRun& run = result.runs[current];
+                run.label = sets.add();
+                // runs of the previous row that end before this run's left neighbor can't touch it or later runs
+                while (previous < previousEnd && result.runs[previous].colEnd < run.colBegin) {
+                    previous++;
+                }
+                for (std::size_t touching = previous;
+                     touching < previousEnd && result.runs[touching].colBegin <= run.colEnd; ++touching) {
+                    sets.unite(run.label, result.runs[touching].label);
+                }
+            }
+            previousBegin = previousEnd;
+        }
+
+        // number sets in order of their roots, which are their first runs in raster order
+        std::vector<int> numbers(sets.size(), 0);
+        for (int label = 1; label < sets.size(); ++label) {
+            int root = sets.find(label);
+            numbers[label] = root == label ? ++result.regionCount : numbers[root];
+        }
+        for (CellRun& run : result.runs) {
+            run.label = numbers[run.label];
+        }
+        return result;
+    }
+
+    std::vector<Region> getRegions(const CellBuffer<bool>& cells) const {
+        return label(cells).toRegions();
+    }
+
+private:
+    // appends runs of live cells of the row in order of columns
+    static void findRuns(const CellBuffer<bool>& cells, int row, std::vector<CellRun>& runs) {
+        const std::uint64_t* words = cells.rowWords(row);
+        int wordCount = cells.getWordsPerRow();
+        int cols = cells.getCols();
+        int runBegin = -1; // start of the run that continues from previous word
+        for (int w = 0; w < wordCount; ++w) {
+            std::uint64_t word = words[w];
+            int base = w * 64;
+            if (w == wordCount - 1 && cols % 64 != 0) {
+                word &= (std::uint64_t{1} << (cols % 64)) - 1; // ignore bits after the last column
+            }
+            // every iteration handles the lowest remaining boundary between dead and live cells
+            std::uint64_t lookFor = runBegin < 0 ? word : ~word; // live cell when outside run, dead one inside
+            while (lookFor != 0) {
+                int bit = countTrailingZeros(lookFor);
+                if (runBegin < 0) {
+                    runBegin = base + bit;
+                    lookFor = ~word & (~std::uint64_t{0} << bit);
+                } else {
+                    runs.push_back(CellRun{row, runBegin, base + bit, 0});
+                    runBegin = -1;
+                    lookFor = word & (~std::uint64_t{0} << bit);
+                }
+            }
+        }
+        if (runBegin >= 0) {
+            runs.push_back(CellRun{row, runBegin, cols, 0});
+        }
+    }
+};
+
+TEST_CASE("runs are found across word boundaries") {
+    CellBuffer<bool> cells(2, 150);
+    for (int c = 60; c < 70; ++c) {
+        cells.setValue(0, c, true);
+    }
+    cells.setValue(0, 0, true);
+    cells.setValue(0, 127, true);
+    cells.setValue(0, 128, true);
+    for (int c = 140; c < 150; ++c) {
+        cells.setValue(0, c, true);
+    }
+    cells.setValue(1, 149, true);
+
+    RunRegions regions = RunLengthLabeler().label(cells);
+    REQUIRE(regions.runs.size() == 5);
+    CHECK(regions.runs[0].colBegin == 0);
+    CHECK(regions.runs[0].colEnd == 1);
+    CHECK(regions.runs[1].colBegin == 60);
+    CHECK(regions.runs[1].colEnd == 70);
+    CHECK(regions.runs[2].colBegin == 127);
+    CHECK(regions.runs[2].colEnd == 129);
+    CHECK(regions.runs[3].colBegin == 140);
+    CHECK(regions.runs[3].colEnd == 150);
+    CHECK(regions.runs[4].row == 1);
+    CHECK(regions.regionCount == 4);
+    CHECK(regions.runs[4].label == regions.runs[3].label);
+}
+
+TEST_CASE("run-length labeling gives the same regions as cell labeling") {
+    for (double density : {0.2, 0.5, 0.9}) {
+        CellBuffer<bool> cells(37, 131);
+        std::mt19937 random(static_cast<unsigned>(density * 10));
+        std::bernoulli_distribution alive(density);
+        for (int r = 0; r < 37; ++r) {
+            for (int c = 0; c < 131; ++c) {
+                cells.setValue(r, c, alive(random));
+            }
+        }
+        std::vector<Region> expected = RegionLabeler().getRegions(cells);
+        std::vector<Region> regions = RunLengthLabeler().getRegions(cells);
+        REQUIRE(regions.size() == expected.size());
+        bool regionsMatch = true;
+        for (std::size_t i = 0; i < regions.size(); ++i) {
+            regionsMatch = regionsMatch && regions[i].getCoordinates() == expected[i].getCoordinates()
+                           && regions[i].getDescriptor().getContentHash() == expected[i].getDescriptor().getContentHash();
+        }
+        CHECK(regionsMatch);
+    }
+}
@@ -0,0 +1,240 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include "../doctest.h"
+
+#include "grid.h"
+#include "neighborhood.h"
+#include "update.h"
+
+// Index of live (non-zero) cells of a grid for radius queries.
+// Grid is divided into square buckets of bucketSize x bucketSize cells, every bucket keeps its live cells.
+// Query looks only at buckets that intersect the box around the center: it takes
+// O(box area / bucketSize^2 + live cells in those buckets), instead of O(box area) for scanning the grid.
+// Small buckets are better for small distances and sparse grids, large ones for large distances.
+// Index is kept up to date by applying changes reported by BasicGrid::update(changes).
+class LiveCellIndex {
+public:
+    static constexpr int defaultBucketSize = 16;
+
+    LiveCellIndex() : rows(0), cols(0), bucketSize(defaultBucketSize), bucketRows(0), bucketCols(0), liveCount(0) {}
+
+    // throws std::invalid_argument if bucketSize is less than 1
+    template <typename ValueT, typename Layout>
+    explicit LiveCellIndex(const BasicGrid<ValueT, Layout>& grid, int bucketSize = defaultBucketSize)
+        : rows(grid.getRows()), cols(grid.getCols()), bucketSize(checkBucketSize(bucketSize)),
+          bucketRows((rows + bucketSize - 1) / bucketSize), bucketCols((cols + bucketSize - 1) / bucketSize),
+          buckets(static_cast<std::size_t>(bucketRows) * bucketCols), liveCount(0) {
+        for (int r = 0; r < rows; ++r) {
+            for (int c = 0; c < cols; ++c) {
+                if (grid.getCellValue(r, c) != 0) {
+                    bucketOf(r, c).emplace_back(r, c);
+                    liveCount++;
+                }
+            }
+        }
+    }
+
+    int getRows() const { return rows; }
+
+    int getCols() const { return cols; }
+
+    int getBucketSize() const { return bucketSize; }
+
+    // number of live cells
+    std::size_t size() const { return liveCount; }
+
+    bool contains(int row, int col) const {
+        if (!isValidCoordinates(row, col)) {
+            return false;
+        }
+        const Bucket& bucket = bucketOf(row, col);
+        return std::find(bucket.begin(), bucket.end(), std::make_pair(row, col)) != bucket.end();
+    }
+
+    // marks cell as live; does nothing if it is already live
+    void insert(int row, int col) {
+        if (!isValidCoordinates(row, col)) {
+            throw std::out_of_range("Cell index out of range");
+        }
+        Bucket& bucket = bucketOf(row, col);
+        if (std::find(bucket.begin(), bucket.end(), std::make_pair(row, col)) == bucket.end()) {
+            bucket.emplace_back(row, col);
+            liveCount++;
+        }
+    }
+
+    // marks cell as dead; does nothing if it is not live
+    void erase(int row, int col) {
+        if (!isValidCoordinates(row, col)) {
+            throw std::out_of_range("Cell index out of range");
+        }
+        Bucket& bucket = bucketOf(row, col);
+        auto position = std::find(bucket.begin(), bucket.end(), std::make_pair(row, col));
+        if (position != bucket.end()) {
+            *position = bucket.back(); // order inside a bucket does not matter
+            bucket.pop_back();
+            liveCount--;
+        }
+    }
+
+    // updates index after grid.update(changes), work is proportional to the number of changes
+    template <typename ValueT>
+    void apply(const std::vector<CellChange<ValueT>>& changes) {
+        for (const auto& change : changes) {
+            if (change.value != 0) {
+                insert(change.row, change.col);
+            } else {
+                erase(change.row, change.col);
+            }
+        }
+    }
+
+    // Calls visit(row, col) for every live cell within distance from (row, col), in no particular order.
+    // Every live cell of the buckets around the box is checked, also those outside the distance.
+    template <typename Visitor>
+    void forEachWithinDistance(int row, int col, DistanceType distanceType, int distance, Visitor&& visit) const {
+        // box around the center in 64 bits, so a large distance does not overflow
+        std::int64_t top = std::int64_t{row} - distance;
+        std::int64_t bottom = std::int64_t{row} + distance;
+        std::int64_t left = std::int64_t{col} - distance;
+        std::int64_t right = std::int64_t{col} + distance;
+        // nothing to do if it does not intersect the grid
+        if (distance < 0 || bottom < 0 || top >= rows || right < 0 || left >= cols) {
+            return;
+        }
+        int firstBucketRow = static_cast<int>(std::max<std::int64_t>(0, top)) / bucketSize;
+        int lastBucketRow = static_cast<int>(std::min<std::int64_t>(rows - 1, bottom)) / bucketSize;
+        int firstBucketCol = static_cast<int>(std::max<std::int64_t>(0, left)) / bucketSize;
+        int lastBucketCol = static_cast<int>(std::min<std::int64_t>(cols - 1, right)) / bucketSize;
+        for (int bucketRow = firstBucketRow; bucketRow <= lastBucketRow; ++bucketRow) {
+            for (int bucketCol = firstBucketCol; bucketCol <= lastBucketCol; ++bucketCol) {
+                for (const auto& [r, c] : buckets[static_cast<std::size_t>(bucketRow) * bucketCols + bucketCol]) {
+                    if (isWithinDistance(std::int64_t{r} - row, std::int64_t{c} - col, distanceType, distance)) {
+                        visit(r, c);
+                    }
+                }
+            }
+        }
+    }
+
+    // live cells within distance from (row, col) in row-major order,
+    // the same cells as live cells of getNeighborhoodByDistance(row, col, distanceType, distance)
+    std::vector<std::pair<int, int>> findWithinDistance(int row, int col, DistanceType distanceType,
+                                                        int distance) const {
+        std::vector<std::pair<int, int>> found;
+        forEachWithinDistance(row, col, distanceType, distance, [&](int r, int c) {
+            found.emplace_back(r, c);
+        });
+        std::sort(found.begin(), found.end());
+        return found;
+    }
+
+private:
+    using Bucket = std::vector<std::pair<int, int>>;
+
+    static int checkBucketSize(int bucketSize) {
+        if (bucketSize < 1) {
+            throw std::invalid_argument("Bucket size must be at least 1");
+        }
+        return bucketSize;
+    }
+
+    bool isValidCoordinates(int row, int col) const {
+        return row >= 0 && row < rows && col >= 0 && col < cols;
+    }
+
+    Bucket& bucketOf(int row, int col) {
+        return buckets[static_cast<std::size_t>(row / bucketSize) * bucketCols + col / bucketSize];
+    }
+
+    const Bucket& bucketOf(int row, int col) const {
+        return buckets[static_cast<std::size_t>(row / bucketSize) * bucketCols + col / bucketSize];
+    }
+
+    int rows;
+    int cols;
+    int bucketSize;
+    int bucketRows;
+    int bucketCols;
+    std::vector<Bucket> buckets; // row-major order of buckets
+    std::size_t liveCount;
+};
+
+TEST_CASE("LiveCellIndex finds live cells within distance") {
+    Grid grid(40, 50);
+    grid.fillGridWithRandomValues({0, 1}, {0.9, 0.1});
+    LiveCellIndex index(grid);
+
+    std::size_t live = 0;
+    for (int r = 0; r < 40; ++r) {
+        for (int c = 0; c < 50; ++c) {
+            live += grid.getCellValue(r, c) != 0;
+        }
+    }
+    CHECK(index.size() == live);
+    CHECK(index.getBucketSize() == LiveCellIndex::defaultBucketSize);
+    LiveCellIndex single(grid, 1);
+    LiveCellIndex odd(grid, 7);
+    LiveCellIndex whole(grid, 64); // one bucket for the whole grid
+    CHECK_THROWS_AS(LiveCellIndex(grid, 0), std::invalid_argument);
+
+    for (DistanceType type : {DistanceType::Euclidean, DistanceType::Manhattan, DistanceType::Chebyshev}) {
+        for (auto [row, col, distance] : {std::tuple<int, int, int>{0, 0, 3}, {20, 25, 7}, {39, 10, 20},
+                                          {5, 49, 0}, {-3, 60, 5}, {10, 10, 100}}) {
+            std::vector<std::pair<int, int>> expected;
+            for (const auto& [r, c] : grid.getNeighborhoodByDistance(row, col, type, distance)) {
+                if (grid.getCellValue(r, c) != 0) {
+                    expected.emplace_back(r, c);
+                }
+            }
+            CHECK(index.findWithinDistance(row, col, type, distance) == expected);
+            CHECK(single.findWithinDistance(row, col, type, distance) == expected);
+            CHECK(odd.findWithinDistance(row, col, type, distance) == expected);
+            CHECK(whole.findWithinDistance(row, col, type, distance) == expected);
+        }
+
+        // distances whose square or box does not fit into int find all live cells
+        for (int distance : {100000, std::numeric_limits<int>::max()}) {
+            CHECK(index.findWithinDistance(20, 25, type, distance).size() == live);
+        }
+    }
+    // box of a far center reaches the grid only with the largest distance
+    int far = std::numeric_limits<int>::max();
+    CHECK(odd.findWithinDistance(-1000, far, DistanceType::Chebyshev, far).size() == live);
+    CHECK(odd.findWithinDistance(-1000, far, DistanceType::Chebyshev, 100000).empty());
+    CHECK(isWithinDistance(60000, 0, DistanceType::Euclidean, 60000));
+    CHECK(!isWithinDistance(60000, 1, DistanceType::Euclidean, 60000));
+}
+
+TEST_CASE("LiveCellIndex follows grid updates") {
+    Grid grid(30, 35);
+    grid.fillGridWithRandomValues({0, 1}, {0.7, 0.3});
+    LiveCellIndex index(grid);
+
+    std::vector<CellChange<int>> changes;
+    for (int generation = 0; generation < 5; ++generation) {
+        grid.update(changes);
+        index.apply(changes);
+    }
+
+    LiveCellIndex rebuilt(grid);
+    CHECK(index.size() == rebuilt.size());
+    CHECK(index.findWithinDistance(15, 17, DistanceType::Chebyshev, 40)
+          == rebuilt.findWithinDistance(15, 17, DistanceType::Chebyshev, 40));
+
+    index.insert(0, 0);
+    index.insert(0, 0);
+    CHECK(index.contains(0, 0));
+    index.erase(0, 0);
+    CHECK(!index.contains(0, 0));
+    CHECK_THROWS_AS(index.insert(30, 0), std::out_of_range);
+}
@@ -0,0 +1,337 @@
+#pragma once
+
+#if defined(__linux__)
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "../doctest.h"
+
+#include "cell_buffer.h"
+#include "grid.h"
+#include "mapped_grid.h"
+#include "update.h"
+
+// Bounded queue that passes rows from one thread to another.
+// push() waits while the queue is full, pop() waits while it is empty.
+template <typename T>
+class RowQueue {
+public:
+    explicit RowQueue(std::size_t capacity) : capacity(std::max<std::size_t>(1, capacity)) {}
+
+    // returns false if the queue was closed, then row is dropped
+    bool push(T row) {
+        std::unique_lock<std::mutex> lock(mutex);
+        notFull.wait(lock, [&] { return closed || rows.size() < capacity; });
+        if (closed) {
+            return false;
+        }
+        rows.push_back(std::move(row));
+        notEmpty.notify_one();
+        return true;
+    }
+
+    // returns false if the queue is closed and there are no more rows
+    bool pop(T& row) {
+        std::unique_lock<std::mutex> lock(mutex);
+        notEmpty.wait(lock, [&] { return closed || !rows.empty(); });
+        if (rows.empty()) {
+            return false;
+        }
+        row = std::move(rows.front());
+        rows.pop_front();
+        notFull.notify_one();
+        return true;
+    }
+
+    // rows that are already in the queue can still be popped
+    void close() {
+        std::lock_guard<std::mutex> lock(mutex);
+        closed = true;
+        notEmpty.notify_all();
+        notFull.notify_all();
+    }
+
+private:
+    std::size_t capacity;
+    std::deque<T> rows;
+    bool closed = false;
+    std::mutex mutex;
+    std::condition_variable notEmpty;
+    std::condition_variable notFull;
+};
+
+// Computes the next generation of a grid file (format of MappedGrid) into another grid file
+// without loading the grid into memory. The rule needs only the rows above and below,
+// so cells are kept in a window of three rows that slides down the grid: memory is O(cols).
+// One thread reads rows of the input file, another writes rows of the output file,
+// and the calling thread computes, so disk transfers overlap with computation.
+// Rows go between the threads in a fixed set of row buffers that are returned to their sender
+// after use, so no memory is allocated per row.
+// Output file has a zero header, which is not a valid grid file, until all rows are written and on disk.
+class StreamingUpdater {
+public:
+    // rowsInFlight is the number of rows that can wait in each of the read and write queues
+    explicit StreamingUpdater(std::size_t rowsInFlight = 64) : rowsInFlight(rowsInFlight) {}
+
+    // Writes generation that follows the current generation of inputPath into a new file outputPath
+    // (existing file is replaced). Paths should be different.
+    // Returns true if any cell changed. Throws std::runtime_error on I/O errors or wrong input file.
+    template <typename ValueT>
+    bool update(const std::string& inputPath, const std::string& outputPath) const {
+        using StorageType = typename CellBuffer<ValueT>::StorageType;
+        using Row = std::vector<StorageType>;
+
+        ScopedFile input(::open(inputPath.c_str(), O_RDONLY));
+        if (input.descriptor < 0) {
+            throw std::runtime_error("Can't open grid file " + inputPath);
+        }
+        struct stat status;
+        MappedGridHeader inputHeader;
+        if (fstat(input.descriptor, &status) != 0
+            || pread(input.descriptor, &inputHeader, sizeof(inputHeader), 0) != sizeof(inputHeader)) {
+            throw std::runtime_error("Not a grid file: " + inputPath);
+        }
+        MappedGrid<ValueT>::checkHeader(inputHeader, static_cast<std::size_t>(status.st_size), inputPath);
+        posix_fadvise(input.descriptor, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+        int rows = inputHeader.rows;
+        int cols = inputHeader.cols;
+        MappedGridHeader outputHeader = MappedGrid<ValueT>::makeHeader(rows, cols);
+        outputHeader.generation = inputHeader.generation + 1;
+
+        ScopedFile output(::open(outputPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644));
+        if (output.descriptor < 0) {
+            throw std::runtime_error("Can't create grid file " + outputPath);
+        }
+        // file is filled with zeros, so until the header is written at the end it is not a grid file
+        if (ftruncate(output.descriptor, static_cast<off_t>(MappedGrid<ValueT>::getFileSize(outputHeader))) != 0) {
+            throw std::runtime_error("Can't resize grid file " + outputPath);
+        }
+
+        std::size_t rowSize = CellBuffer<ValueT>::storageSize(1, cols);
+        std::size_t rowBytes = rowSize * sizeof(StorageType);
+        RowQueue<Row> readRows(rowsInFlight);
+        RowQueue<Row> writtenRows(rowsInFlight);
+        // every row buffer is in a queue or held by one thread, so the free queues never get full
+        std::size_t poolSize = rowsInFlight + 2;
+        RowQueue<Row> freeReadRows(poolSize);
+        RowQueue<Row> freeWrittenRows(poolSize);
+        for (std::size_t i = 0; i < poolSize; ++i) {
+            freeReadRows.push(Row(rowSize));
+            freeWrittenRows.push(Row(rowSize));
+        }
+        std::exception_ptr readError;
+        std::exception_ptr writeError;
+
+        std::thread reader([&] {
+            try {
+                Row row;
+                for (int r = 0; r < rows && freeReadRows.pop(row); ++r) {
+                    readFully(input.descriptor, row.data(), rowBytes,
+                              inputHeader.bufferOffset[inputHeader.currentBuffer] + r * rowBytes, inputPath);
+                    if (!readRows.push(std::move(row))) {
+                        break;
+                    }
+                }
+            } catch (...) {
+                readError = std::current_exception();
+            }
+            readRows.close();
+        });
+
+        std::thread writer([&] {
+            try {
+                Row row;
+                for (int r = 0; writtenRows.pop(row); ++r) {
+                    writeFully(output.descriptor, row.data(), rowBytes,
+                               outputHeader.bufferOffset[0] + r * rowBytes, outputPath);
+                    freeWrittenRows.push(std::move(row));
+                }
+            } catch (...) {
+                writeError = std::current_exception();
+                writtenRows.close(); // stop computing thread if it waits for free space
+                freeWrittenRows.close();
+            }
+        });
+
+        // Rows r - 1, r and r + 1 of the input and row r of the output are rows 0, 1 and 2 of 3-row buffers.
+        // Rows outside the grid are dead cells, which are not counted as neighbors anyway,
+        // so updating the middle row of the window gives the same result as updating the whole grid.
+        GridArray<StorageType> windowStorage(3 * rowSize);
+        GridArray<StorageType> nextStorage(3 * rowSize);
+        CellBuffer<ValueT> window(3, cols, GridArray<StorageType>::view(windowStorage.data(), 3 * rowSize));
+        CellBuffer<ValueT> next(3, cols, GridArray<StorageType>::view(nextStorage.data(), 3 * rowSize));
+        Row row;
+        auto loadRow = [&](int slot) {
+            if (!readRows.pop(row)) {
+                return false;
+            }
+            std::memcpy(windowStorage.data() + slot * rowSize, row.data(), rowBytes);
+            freeReadRows.push(std::move(row));
+            return true;
+        };
+
+        bool hasChanged = false;
+        bool complete = rows == 0 || (loadRow(1) && (rows == 1 || loadRow(2)));
+        for (int r = 0; complete && r < rows; ++r) {
+            hasChanged = updater.updateRows(window, next, 1, 2) || hasChanged;
+            if (!freeWrittenRows.pop(row)) {
+                complete = false;
+                break;
+            }
+            std::memcpy(row.data(), nextStorage.data() + rowSize, rowBytes);
+            if (!writtenRows.push(std::move(row))) {
+                complete = false;
+                break;
+            }
+
+            std::memmove(windowStorage.data(), windowStorage.data() + rowSize, 2 * rowBytes);
+            if (r + 2 < rows) {
+                complete = loadRow(2);
+            } else {
+                std::fill(windowStorage.data() + 2 * rowSize, windowStorage.data() + 3 * rowSize, StorageType());
+            }
+        }
+
+        readRows.close();
+        writtenRows.close();
+        freeReadRows.close();
+        freeWrittenRows.close();
+        reader.join();
+        writer.join();
+        if (readError) {
+            std::rethrow_exception(readError);
+        }
+        if (writeError) {
+            std::rethrow_exception(writeError);
+        }
+        if (!complete) {
+            throw std::runtime_error("Can't read grid file " + inputPath);
+        }
+
+        // cells are on disk before the header that makes the file valid
+        if (fdatasync(output.descriptor) != 0) {
+            throw std::runtime_error("Can't write grid file " + outputPath);
+        }
+        writeFully(output.descriptor, &outputHeader, sizeof(outputHeader), 0, outputPath);
+        return hasChanged;
+    }
+
+private:
+    // closes file descriptor when leaving scope
+    struct ScopedFile {
+        explicit ScopedFile(int descriptor) : descriptor(descriptor) {}
+        ScopedFile(const ScopedFile&) = delete;
+        ScopedFile& operator=(const ScopedFile&) = delete;
+        ~ScopedFile() {
+            if (descriptor >= 0) {
+                ::close(descriptor);
+            }
+        }
+        int descriptor;
+    };
+
+    static void readFully(int file, void* data, std::size_t bytes, std::uint64_t offset, const std::string& path) {
+        char* position = static_cast<char*>(data);
+        while (bytes > 0) {
+            ssize_t count = pread(file, position, bytes, static_cast<off_t>(offset));
+            if (count <= 0) {
+                throw std::runtime_error("Can't read grid file " + path);
+            }
+            position += count;
+            offset += count;
+            bytes -= count;
+        }
+    }
+
+    static void writeFully(int file, const void* data, std::size_t bytes, std::uint64_t offset,
+                           const std::string& path) {
+        const char* position = static_cast<const char*>(data);
+        while (bytes > 0) {
+            ssize_t count = pwrite(file, position, bytes, static_cast<off_t>(offset));
+            if (count <= 0) {
+                throw std::runtime_error("Can't write grid file " + path);
+            }
+            position += count;
+            offset += count;
+            bytes -= count;
+        }
+    }
+
+    std::size_t rowsInFlight;
+    Updater updater;
+};
+
+TEST_CASE("streaming update gives the same result as Updater") {
+    std::string first = "test_streaming_a.bin";
+    std::string second = "test_streaming_b.bin";
+    Grid expected(20, 30);
+    {
+        MappedGrid<int> grid = MappedGrid<int>::create(first, 20, 30);
+        for (int r = 0; r < 20; ++r) {
+            for (int c = 0; c < 30; ++c) {
+                int value = (r * 7 + c * 13) % 5 < 2;
+                grid.setCellValue(r, c, value);
+                expected.setCellValue(r, c, value);
+            }
+        }
+    }
+
+    StreamingUpdater streaming(2); // small queues, so threads have to wait for each other
+    for (int generation = 0; generation < 6; ++generation) {
+        bool expectedChange = expected.update();
+        CHECK(streaming.update<int>(first, second) == expectedChange);
+        std::swap(first, second); // output of this generation is input of the next one
+    }
+    MappedGrid<int> result = MappedGrid<int>::open(first);
+    CHECK(result.getGeneration() == 6);
+    CHECK(result.toGrid().gridToString() == expected.gridToString());
+
+    CHECK_THROWS_AS(streaming.update<std::uint8_t>(first, second), std::runtime_error); // another cell type
+    std::remove(first.c_str());
+    std::remove(second.c_str());
+    CHECK_THROWS_AS(streaming.update<int>(first, second), std::runtime_error);
+}
+
+TEST_CASE("streaming update of bit-packed and small grids") {
+    const std::string input = "test_streaming_bits_in.bin";
+    const std::string output = "test_streaming_bits_out.bin";
+    {
+        MappedGrid<bool> grid = MappedGrid<bool>::create(input, 3, 100);
+        grid.setCellValue(1, 97, true);
+        grid.setCellValue(1, 98, true);
+        grid.setCellValue(1, 99, true);
+    }
+    StreamingUpdater streaming;
+    CHECK(streaming.update<bool>(input, output));
+    {
+        MappedGrid<bool> grid = MappedGrid<bool>::open(output);
+        CHECK(grid.getCellValue(0, 98));
+        CHECK(grid.getCellValue(2, 98));
+        CHECK(!grid.getCellValue(1, 97));
+    }
+
+    // single row: no rows above and below
+    MappedGrid<int>::create(input, 1, 4);
+    CHECK(!streaming.update<int>(input, output));
+    CHECK(MappedGrid<int>::open(output).getRows() == 1);
+    std::remove(input.c_str());
+    std::remove(output.c_str());
+}
+
+#endif
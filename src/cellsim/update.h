@@ -1,105 +1,225 @@
+#pragma once
+
+#include <algorithm>
 #include <vector>
+#include <cstdint>
+#include <type_traits>
+#include <utility>
 
 #include "cell.h"
+#include "cell_buffer.h"
+#include "neighborhood.h"
+
+// Cell that got a new value during update
+template <typename ValueT>
+struct CellChange {
+    int row;
+    int col;
+    ValueT value; // new value
+
+    bool operator==(const CellChange& other) const {
+        return row == other.row && col == other.col && value == other.value;
+    }
+};
 
-
-enum class DistanceType {
-    Euclidean,
-    Manhattan,
-    Chebyshev
+// What cells outside the grid look like to the update rule
+enum class BoundaryMode {
+    Dead,       // all cells outside the grid are dead
+    Toroidal,   // grid wraps around: the row above the first row is the last row, and the same for columns
+    Reflective  // edge is a mirror: the cell just outside the grid is a copy of the edge cell next to it
 };
 
-class NeighborhoodCalculator {
+// Updater keeps only its boundary mode: neighborhood is calculated from dimensions of the cells it updates,
+// so a single instance can be shared by all grids.
+//
+// Cells are counted from a window of three rows (above, current and below) with a halo of one extra cell
+// on each side. Halo cells are filled from the grid according to the boundary mode when a row
+// enters the window, so the counting loop itself never checks bounds.
+// Grids with MortonLayout are walked tile by tile in storage order instead (see updateTiles).
+class Updater {
 public:
-    // Constructor to accept grid dimensions (could be extended for different grids)
-    NeighborhoodCalculator(int rows, int cols) : rows(rows), cols(cols) {}
-
-    // Function to calculate the neighborhood based on distance type and distance
-    std::vector<std::pair<int, int>> getNeighborhoodByDistance(int row, int col, 
-                                                                DistanceType distanceType, 
-                                                                int distance) const {
-        std::vector<std::pair<int, int>> neighborhood;
-
-        for (int r = -distance; r <= distance; ++r) {
-            for (int c = -distance; c <= distance; ++c) {
-                int newRow = row + r;
-                int newCol = col + c;
-
-                // Check if the new position is within bounds
-                if (newRow < 0 || newRow >= rows || newCol < 0 || newCol >= cols) {
-                    continue;
-                }
+    explicit Updater(BoundaryMode boundaryMode = BoundaryMode::Dead) : boundaryMode(boundaryMode) {}
 
-                // Calculate the distance from the center cell to the current cell
-                double d = 0.0;
+    BoundaryMode getBoundaryMode() const {
+        return boundaryMode;
+    }
 
-                if (distanceType == DistanceType::Euclidean) {
-                    d = std::sqrt(r * r + c * c);
-                } else if (distanceType == DistanceType::Manhattan) {
-                    d = std::abs(r) + std::abs(c);
-                } else if (distanceType == DistanceType::Chebyshev) {
-                    d = std::max(std::abs(r), std::abs(c));
-                }
+    // if changes is not null, cells that changed are appended to it in row-major order
+    template <typename ValueT, typename Layout>
+    CellBuffer<ValueT, Layout> update(const CellBuffer<ValueT, Layout>& cells,
+                                      std::vector<CellChange<ValueT>>* changes = nullptr) const {
+        CellBuffer<ValueT, Layout> newCells(cells.getRows(), cells.getCols());
+        updateRows(cells, newCells, 0, cells.getRows(), changes);
+        return newCells;       
+    }
 
-                // If the distance is within the specified range, add to neighborhood
-                if (d <= distance) {
-                    neighborhood.emplace_back(newRow, newCol);
+    // Writes next state of rows [rowBegin, rowEnd) into newCells, other rows are not touched,
+    // so different row ranges can be updated by different threads.
+    // Returns true if any cell in these rows changed.
+    template <typename ValueT, typename Layout>
+    bool updateRows(const CellBuffer<ValueT, Layout>& cells, CellBuffer<ValueT, Layout>& newCells,
+                    int rowBegin, int rowEnd,
+                    std::vector<CellChange<ValueT>>* changes = nullptr) const {
+        int cols = cells.getCols();
+        if (rowBegin >= rowEnd || cols == 0) {
+            return false;
+        }
+        if constexpr (std::is_same_v<Layout, MortonLayout>) {
+            return updateTiles(cells, newCells, rowBegin, rowEnd, changes);
+        }
+
+        // Ring of three rows with halo: row r of the grid is in slot ringSlot(r), so when the window moves
+        // down only row r + 1 is loaded, into the slot of row r - 2, which is not needed any more.
+        // 1 for alive cells; cell c of a row is at index c + 1, indexes 0 and cols + 1 are the halo
+        std::vector<std::uint8_t> windowCells(3 * (cols + 2));
+        auto ringRow = [&](int row) { return windowCells.data() + ringSlot(row) * (cols + 2); };
+        loadRow(cells, rowBegin - 1, ringRow(rowBegin - 1));
+        loadRow(cells, rowBegin, ringRow(rowBegin));
+
+        bool hasChanged = false;
+        for (int r = rowBegin; r < rowEnd; ++r) {
+            loadRow(cells, r + 1, ringRow(r + 1));
+            const std::uint8_t* const rowsAround[3] = {ringRow(r - 1), ringRow(r), ringRow(r + 1)};
+
+            for (int c = 0; c < cols; ++c) {
+                // cell itself is counted too
+                int aliveNeighbors = countAlive(rowsAround, c + 1, std::make_index_sequence<MooreNeighborhood::size>());
+
+                // window has only 0 or 1, the value itself can be another number
+                ValueT value = cells.getValue(r, c);
+                ValueT newValue = nextValue(value, aliveNeighbors);
+
+                newCells.setValue(r, c, newValue);
+                if (newValue != value) {
+                    hasChanged = true;
+                    if (changes) {
+                        changes->push_back({r, c, newValue});
+                    }
                 }
             }
         }
 
-        return neighborhood;
-    }
-
-    // A simpler interface for getting immediate neighbors (Chebyshev distance 1)
-    std::vector<std::pair<int, int>> getNeighbors(int row, int col) const {
-        return getNeighborhoodByDistance(row, col, DistanceType::Chebyshev, 1);
+        return hasChanged;
     }
 
 private:
-    int rows;
-    int cols;
-};
+    static_assert(MooreNeighborhood::distance == 1, "window has a halo of one cell");
+
+    // Game of Life rule; aliveNeighbors includes the cell itself.
+    // Only 1 is alive. Any other value is not alive: it is not counted as a neighbor and it keeps
+    // its value unless a cell is born there, the same for every layout.
+    template <typename ValueT>
+    static ValueT nextValue(ValueT value, int aliveNeighbors) {
+        if (value == 1) {
+            // Cell is currently alive
+            if (aliveNeighbors < 3 || aliveNeighbors > 4) { // if this cell is alive, aliveNeighbors includes itself, so we add 1
+                return 0; // Die
+            }
+        } else {
+            // Cell is currently dead (0) or holds another value
+            if (aliveNeighbors == 3) {
+                return 1; // Become alive
+            }
+        }
+        return value;
+    }
 
-class Updater {
-public:
-    Updater(NeighborhoodCalculator& neighborhoodCalculator)
-        : neighborhoodCalculator(neighborhoodCalculator) {}
-        
-    std::vector<std::vector<Cell>> update(const std::vector<std::vector<Cell>> cells) {
-        std::vector<std::vector<Cell>> newCells = cells; // Copy current state
-
-        for (int r = 0; r < cells.size(); ++r) {
-            for (int c = 0; c < cells[0].size(); ++c) {
-                int aliveNeighbors = 0;
-
-                // Count alive neighbors using Manhattan distance
-                auto neighborhood = neighborhoodCalculator.getNeighbors(r, c);
-                for (const auto& neighbor : neighborhood) {
-                    if (cells[neighbor.first][neighbor.second].getValue() == 1) {
-                        aliveNeighbors++;
+    // updateRows for tiled Z-order grids: cells are visited tile by tile, in the order they are stored.
+    // Each tile is copied with a halo of one cell into a small block, so counting reads only the block.
+    // Changes of a band of tile rows are sorted, so they are still reported in row-major order.
+    template <typename ValueT>
+    bool updateTiles(const CellBuffer<ValueT, MortonLayout>& cells, CellBuffer<ValueT, MortonLayout>& newCells,
+                     int rowBegin, int rowEnd, std::vector<CellChange<ValueT>>* changes) const {
+        int rows = cells.getRows();
+        int cols = cells.getCols();
+        int tileSize = cells.getLayout().getTileSize();
+        int side = tileSize + 2;
+        std::vector<std::uint8_t> block(static_cast<std::size_t>(side) * side);
+
+        bool hasChanged = false;
+        for (int bandBegin = rowBegin; bandBegin < rowEnd;) {
+            // band ends with the tile row, so that every tile is visited once
+            int bandEnd = std::min(rowEnd, (bandBegin / tileSize + 1) * tileSize);
+            std::size_t firstChange = changes ? changes->size() : 0;
+            for (int colBegin = 0; colBegin < cols; colBegin += tileSize) {
+                int colEnd = std::min(cols, colBegin + tileSize);
+                for (int r = bandBegin - 1; r <= bandEnd; ++r) {
+                    std::uint8_t* blockRow = block.data() + static_cast<std::size_t>(r - bandBegin + 1) * side;
+                    int sourceRow = wrap(r, rows);
+                    for (int c = colBegin - 1; c <= colEnd; ++c) {
+                        int sourceCol = wrap(c, cols);
+                        blockRow[c - colBegin + 1] = sourceRow >= 0 && sourceCol >= 0 && cells.getValue(sourceRow, sourceCol) == 1;
                     }
                 }
-
-                // Apply Game of Life rules
-                if (cells[r][c].getValue() == 1) {
-                    // Cell is currently alive
-                    if (aliveNeighbors < 3 || aliveNeighbors > 4) { // if this cell is alive, aliveNeighbors includes itself, so we add 1
-                        newCells[r][c].setValue(0); // Die
-                    }
-                } else {
-                    assert(cells[r][c].getValue() == 0); // all cells should be either 0 (dead) or 1 (alive)
-                    // Cell is currently dead
-                    if (aliveNeighbors == 3) {
-                        newCells[r][c].setValue(1); // Become alive
+                for (int r = bandBegin; r < bandEnd; ++r) {
+                    const std::uint8_t* middle = block.data() + static_cast<std::size_t>(r - bandBegin + 1) * side;
+                    const std::uint8_t* const rowsAround[3] = {middle - side, middle, middle + side};
+                    for (int c = colBegin; c < colEnd; ++c) {
+                        int aliveNeighbors = countAlive(rowsAround, c - colBegin + 1, std::make_index_sequence<MooreNeighborhood::size>());
+                        ValueT value = cells.getValue(r, c);
+                        ValueT newValue = nextValue(value, aliveNeighbors);
+                        newCells.setValue(r, c, newValue);
+                        if (newValue != value) {
+                            hasChanged = true;
+                            if (changes) {
+                                changes->push_back({r, c, newValue});
+                            }
+                        }
                     }
                 }
             }
+            if (changes) {
+                std::sort(changes->begin() + firstChange, changes->end(), [](const auto& a, const auto& b) {
+                    return std::make_pair(a.row, a.col) < std::make_pair(b.row, b.col);
+                });
+            }
+            bandBegin = bandEnd;
         }
+        return hasChanged;
+    }
 
-        return newCells;       
+    // slot of the window ring that holds row (row may be -1)
+    static int ringSlot(int row) {
+        return (row % 3 + 3) % 3;
+    }
+
+    // Sum of the window cells around position index of the middle row, one term per offset of the neighborhood
+    template <std::size_t... Indexes>
+    static int countAlive(const std::uint8_t* const (&window)[3], int index, std::index_sequence<Indexes...>) {
+        return (0 + ... + window[1 + MooreNeighborhood::offsets[Indexes].row][index + MooreNeighborhood::offsets[Indexes].col]);
+    }
+
+    // Index of the grid row or column that is seen at position index (which may be outside [0, size)),
+    // or -1 if it is a dead cell outside the grid
+    int wrap(int index, int size) const {
+        if (index >= 0 && index < size) {
+            return index;
+        }
+        switch (boundaryMode) {
+            case BoundaryMode::Toroidal: return (index % size + size) % size;
+            case BoundaryMode::Reflective: return index < 0 ? 0 : size - 1;
+            case BoundaryMode::Dead: break;
+        }
+        return -1;
     }
-private:
-    NeighborhoodCalculator& neighborhoodCalculator;
 
-};
\ No newline at end of file
+    // Fills one row of the window (with halo) from row of the grid seen at position row
+    template <typename ValueT, typename Layout>
+    void loadRow(const CellBuffer<ValueT, Layout>& cells, int row, std::uint8_t* haloRow) const {
+        int cols = cells.getCols();
+        int source = wrap(row, cells.getRows());
+        if (source < 0) {
+            std::fill(haloRow, haloRow + cols + 2, std::uint8_t{0});
+            return;
+        }
+        for (int c = 0; c < cols; ++c) {
+            haloRow[c + 1] = cells.getValue(source, c) == 1;
+        }
+        int left = wrap(-1, cols);
+        int right = wrap(cols, cols);
+        haloRow[0] = left < 0 ? 0 : haloRow[left + 1];
+        haloRow[cols + 1] = right < 0 ? 0 : haloRow[right + 1];
+    }
+
+    BoundaryMode boundaryMode;
+};